@@ -0,0 +1,295 @@
+// Memory Benchmark
+//
+// Times copy_memory and zero_memory against the C library's memmove, memcpy
+// and memset over a range of sizes, after checking that they give the same
+// results for every small size and alignment. It also checks that a pool
+// hands out each of its slots once, zeroed, and reuses freed ones.
+
+#include "../Source/memory.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#if !defined(_WIN32_LEAN_AND_MEAN)
+#define _WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef enum Operation
+{
+    OPERATION_COPY,
+    OPERATION_COPY_OVERLAPPING,
+    OPERATION_ZERO,
+} Operation;
+
+static double get_seconds(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec * 1e-9);
+#endif
+}
+
+static void fill_pattern(uint8_t* memory, uint64_t bytes, uint32_t seed)
+{
+    for(uint64_t index = 0; index < bytes; index += 1)
+    {
+        seed = (seed * 1664525) + 1013904223;
+        memory[index] = (uint8_t) (seed >> 24);
+    }
+}
+
+static bool check_copy(uint8_t* ours, uint8_t* theirs, int size, int to_offset, int from_offset)
+{
+    const int span = 256;
+    fill_pattern(ours, span, 7);
+    fill_pattern(theirs, span, 7);
+    copy_memory(ours + to_offset, ours + from_offset, size);
+    memmove(theirs + to_offset, theirs + from_offset, size);
+    return memcmp(ours, theirs, span) == 0;
+}
+
+static bool check_zero(uint8_t* ours, uint8_t* theirs, int size, int offset)
+{
+    const int span = 256;
+    fill_pattern(ours, span, 11);
+    fill_pattern(theirs, span, 11);
+    zero_memory(ours + offset, size);
+    memset(theirs + offset, 0, size);
+    return memcmp(ours, theirs, span) == 0;
+}
+
+// Every size up to 160 bytes at every pair of offsets up to 48, which covers
+// overlap in both directions and each path through the chunked loops.
+static bool check_results(void)
+{
+    uint8_t ours[256];
+    uint8_t theirs[256];
+
+    for(int size = 0; size <= 160; size += 1)
+    {
+        for(int to_offset = 0; to_offset < 48; to_offset += 1)
+        {
+            if(!check_zero(ours, theirs, size, to_offset))
+            {
+                fprintf(stderr, "zero_memory differs from memset for %i bytes at offset %i.\n", size, to_offset);
+                return false;
+            }
+
+            for(int from_offset = 0; from_offset < 48; from_offset += 1)
+            {
+                if(!check_copy(ours, theirs, size, to_offset, from_offset))
+                {
+                    fprintf(stderr, "copy_memory differs from memmove for %i bytes from offset %i to %i.\n", size, from_offset, to_offset);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool is_zeroed(const uint8_t* memory, int bytes)
+{
+    for(int index = 0; index < bytes; index += 1)
+    {
+        if(memory[index])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_pool(void)
+{
+    enum { objects_count = 16, object_size = 40 };
+
+    Allocator pool;
+    if(!pool_create(&pool, NULL, object_size, objects_count))
+    {
+        fprintf(stderr, "Failed to create a pool.\n");
+        return false;
+    }
+
+    bool passed = true;
+    uint8_t* objects[objects_count];
+
+    for(int index = 0; index < objects_count && passed; index += 1)
+    {
+        objects[index] = allocate(&pool, object_size);
+        passed = objects[index] && is_zeroed(objects[index], object_size);
+        for(int prior = 0; prior < index && passed; prior += 1)
+        {
+            passed = objects[index] >= objects[prior] + object_size || objects[prior] >= objects[index] + object_size;
+        }
+        if(passed)
+        {
+            memset(objects[index], 0xa5, object_size);
+        }
+    }
+
+    passed = passed && !allocate(&pool, object_size);
+
+    if(passed)
+    {
+        deallocate(&pool, objects[5], object_size);
+        uint8_t* reused = allocate(&pool, object_size);
+        passed = reused == objects[5] && is_zeroed(reused, object_size);
+    }
+
+    pool_destroy(&pool);
+
+    if(!passed)
+    {
+        fprintf(stderr, "The pool handed out a slot twice, past its end or without zeroing it.\n");
+    }
+
+    return passed;
+}
+
+static void run_operation(Operation operation, bool use_library, uint8_t* buffer, uint64_t bytes)
+{
+    switch(operation)
+    {
+        case OPERATION_COPY:
+        {
+            // Offset by a few bytes so the source isn't aligned like the
+            // destination.
+            uint8_t* to = buffer;
+            uint8_t* from = buffer + bytes + 3;
+            if(use_library)
+            {
+                memcpy(to, from, bytes);
+            }
+            else
+            {
+                copy_memory(to, from, bytes);
+            }
+            break;
+        }
+        case OPERATION_COPY_OVERLAPPING:
+        {
+            uint8_t* to = buffer + 40;
+            uint8_t* from = buffer;
+            if(use_library)
+            {
+                memmove(to, from, bytes);
+            }
+            else
+            {
+                copy_memory(to, from, bytes);
+            }
+            break;
+        }
+        case OPERATION_ZERO:
+        {
+            if(use_library)
+            {
+                memset(buffer, 0, bytes);
+            }
+            else
+            {
+                zero_memory(buffer, bytes);
+            }
+            break;
+        }
+    }
+}
+
+// Returns the throughput in gigabytes per second.
+static double time_operation(Operation operation, bool use_library, uint8_t* buffer, uint64_t bytes)
+{
+    const uint64_t bytes_per_run = UINT64_C(1) << 31;
+    uint64_t repeats = bytes_per_run / bytes;
+    if(repeats < 4)
+    {
+        repeats = 4;
+    }
+
+    // Warm the caches and the page tables first.
+    run_operation(operation, use_library, buffer, bytes);
+
+    double start = get_seconds();
+    for(uint64_t repeat = 0; repeat < repeats; repeat += 1)
+    {
+        run_operation(operation, use_library, buffer, bytes);
+    }
+    double elapsed = get_seconds() - start;
+
+    return (repeats * (double) bytes) / (elapsed * 1e9);
+}
+
+int main(int argc, const char** argv)
+{
+    if(!check_results())
+    {
+        return 1;
+    }
+    printf("Results match the C library.\n");
+
+    if(!check_pool())
+    {
+        return 1;
+    }
+    printf("Pool slots are handed out once and zeroed.\n");
+
+    static const uint64_t sizes[] =
+    {
+        64,
+        1024,
+        64 * 1024,
+        1024 * 1024,
+        1280 * 720 * 4,
+        64 * 1024 * 1024,
+    };
+    const int sizes_count = sizeof(sizes) / sizeof(*sizes);
+
+    static const char* operation_names[] =
+    {
+        "copy",
+        "copy overlapping",
+        "zero",
+    };
+
+    uint64_t max_size = sizes[sizes_count - 1];
+    uint64_t buffer_size = (2 * max_size) + 64;
+    uint8_t* buffer = malloc(buffer_size);
+    if(!buffer)
+    {
+        fprintf(stderr, "Failed to allocate the buffer.\n");
+        return 1;
+    }
+    fill_pattern(buffer, buffer_size, 3);
+
+    printf("%-18s %10s %12s %12s %8s\n", "operation", "bytes", "ours GB/s", "libc GB/s", "ratio");
+
+    for(int operation = 0; operation < 3; operation += 1)
+    {
+        for(int size_index = 0; size_index < sizes_count; size_index += 1)
+        {
+            uint64_t bytes = sizes[size_index];
+            double ours = time_operation(operation, false, buffer, bytes);
+            double theirs = time_operation(operation, true, buffer, bytes);
+            printf("%-18s %10llu %12.2f %12.2f %8.2f\n", operation_names[operation], (unsigned long long) bytes, ours, theirs, ours / theirs);
+        }
+    }
+
+    free(buffer);
+
+    return 0;
+}
@@ -0,0 +1,607 @@
+// Path Tracer Benchmark
+//
+// Renders a fixed set of scenes with fixed seeds and reports how fast it went
+// as JSON, so that runs from different builds can be compared.
+//
+// For each scene, the whole image is rendered once by every thread and the
+// counts of rays traced are divided by the wall time. Utilisation is the share
+// of the wall time that each thread spent rendering tiles. The time per
+// intersection test is measured separately on one thread, by finding the
+// closest hit for a camera ray through each pixel and then for a ray bounced
+// in a random direction off each surface those hit. Those are coherent and
+// incoherent rays, which traverse the hierarchy very differently.
+
+#include "../Source/render.h"
+#include "../Source/render_internal.h"
+#include "../Source/scene.h"
+#include "../Source/thread_pool.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool (*SceneCreateCall)(World* world, Camera* camera);
+
+typedef struct BenchScene
+{
+    const char* name;
+    SceneCreateCall create;
+} BenchScene;
+
+typedef struct BenchSettings
+{
+    Int2 dimensions;
+    uint64_t seed;
+    Integrator integrator;
+    int samples_per_pixel;
+    int threads_count;
+} BenchSettings;
+
+typedef struct SceneResult
+{
+    double build_seconds;
+    double wall_seconds;
+    double primary_nanoseconds;
+    double secondary_nanoseconds;
+    uint64_t closest_hit_rays;
+    uint64_t primary_rays;
+    uint64_t shadow_rays;
+    int primitives_count;
+    int secondary_rays_count;
+} SceneResult;
+
+// A torus on a ground plane under the sky, tessellated finely enough that
+// its triangles far outnumber the pixels.
+static bool create_mesh_scene(World* world, Camera* camera)
+{
+    Camera mesh_camera =
+    {
+        .position = {0.0f, -5.0f, 2.5f},
+        .target = {0.0f, 0.0f, 0.5f},
+        .field_of_view = (float) M_PI_4,
+    };
+    *camera = mesh_camera;
+
+    Material background =
+    {
+        .emittance = {0.3f, 0.4f, 0.5f},
+    };
+
+    Material ground =
+    {
+        .reflectance = {0.5f, 0.5f, 0.5f},
+    };
+
+    Material glossy =
+    {
+        .reflectance = {0.7f, 0.5f, 0.3f},
+        .glossiness = 0.7f,
+    };
+
+    world_add_material(world, background);
+    int ground_index = world_add_material(world, ground);
+    int glossy_index = world_add_material(world, glossy);
+
+    Plane plane =
+    {
+        .normal = float3_unit_z,
+        .d = 0.0f,
+        .material_index = ground_index,
+    };
+    world_add_plane(world, plane);
+
+    const int rings = 512;
+    const int sides = 256;
+    const float major_radius = 1.5f;
+    const float minor_radius = 0.5f;
+
+    int triangles_count = 2 * rings * sides;
+    Triangle* triangles = malloc(sizeof(Triangle) * triangles_count);
+    if(!triangles)
+    {
+        return false;
+    }
+
+    int count = 0;
+
+    for(int ring = 0; ring < rings; ring += 1)
+    {
+        for(int side = 0; side < sides; side += 1)
+        {
+            Float3 corners[4];
+            for(int corner = 0; corner < 4; corner += 1)
+            {
+                float u = (2.0f * (float) M_PI * (ring + (corner & 1))) / rings;
+                float v = (2.0f * (float) M_PI * (side + (corner >> 1))) / sides;
+                float distance = major_radius + (minor_radius * cosf(v));
+                corners[corner].x = distance * cosf(u);
+                corners[corner].y = distance * sinf(u);
+                corners[corner].z = minor_radius + (minor_radius * sinf(v));
+            }
+
+            triangles[count].vertices[0] = corners[0];
+            triangles[count].vertices[1] = corners[1];
+            triangles[count].vertices[2] = corners[3];
+            triangles[count + 1].vertices[0] = corners[0];
+            triangles[count + 1].vertices[1] = corners[3];
+            triangles[count + 1].vertices[2] = corners[2];
+            count += 2;
+        }
+    }
+
+    world_add_mesh(world, triangles, triangles_count, glossy_index);
+    free(triangles);
+
+    return world_build_bvh(world);
+}
+
+// A grid of thousands of small spheres of random sizes and materials on a
+// ground plane, with a few of them glowing.
+static bool create_spheres_scene(World* world, Camera* camera)
+{
+    Camera spheres_camera =
+    {
+        .position = {0.0f, -14.0f, 6.0f},
+        .target = {0.0f, 0.0f, 0.0f},
+        .field_of_view = (float) M_PI_4,
+    };
+    *camera = spheres_camera;
+
+    Material background =
+    {
+        .emittance = {0.1f, 0.12f, 0.15f},
+    };
+
+    Material ground =
+    {
+        .reflectance = {0.5f, 0.5f, 0.5f},
+    };
+
+    Material matte =
+    {
+        .reflectance = {0.7f, 0.3f, 0.3f},
+    };
+
+    Material glossy =
+    {
+        .reflectance = {0.3f, 0.5f, 0.7f},
+        .glossiness = 0.8f,
+    };
+
+    Material glowing =
+    {
+        .emittance = {4.0f, 3.5f, 3.0f},
+        .reflectance = {0.5f, 0.5f, 0.5f},
+    };
+
+    world_add_material(world, background);
+    int ground_index = world_add_material(world, ground);
+    int material_indices[3];
+    material_indices[0] = world_add_material(world, matte);
+    material_indices[1] = world_add_material(world, glossy);
+    material_indices[2] = world_add_material(world, glowing);
+
+    Plane plane =
+    {
+        .normal = float3_unit_z,
+        .d = 0.0f,
+        .material_index = ground_index,
+    };
+    world_add_plane(world, plane);
+
+    RandomGenerator generator;
+    random_seed(&generator, 1);
+
+    const int side = 64;
+    const float spacing = 0.3f;
+
+    for(int y = 0; y < side; y += 1)
+    {
+        for(int x = 0; x < side; x += 1)
+        {
+            float radius = random_float_range(&generator, 0.05f, 0.14f);
+            int material = random_int_range(&generator, 0, 1);
+            if(random_int_range(&generator, 0, 63) == 0)
+            {
+                material = 2;
+            }
+
+            Sphere sphere;
+            sphere.center.x = spacing * (x - (side / 2));
+            sphere.center.y = spacing * (y - (side / 2));
+            sphere.center.z = radius;
+            sphere.radius = radius;
+            sphere.material_index = material_indices[material];
+            world_add_sphere(world, sphere);
+        }
+    }
+
+    return world_build_bvh(world);
+}
+
+static Float3 random_direction(RandomGenerator* generator)
+{
+    for(;;)
+    {
+        Float3 v;
+        v.x = random_float_range(generator, -1.0f, 1.0f);
+        v.y = random_float_range(generator, -1.0f, 1.0f);
+        v.z = random_float_range(generator, -1.0f, 1.0f);
+        float squared_length = float3_squared_length(v);
+        if(squared_length > 1e-4f && squared_length <= 1.0f)
+        {
+            return float3_divide(v, sqrtf(squared_length));
+        }
+    }
+}
+
+// Keeps the results of the timed loops live, so the calls can't be dropped.
+static float hit_distance_sum;
+
+static double time_intersections(const Ray* rays, int rays_count, World* world)
+{
+    if(rays_count == 0)
+    {
+        return 0.0;
+    }
+
+    float distance_sum = 0.0f;
+
+    double start = get_time_seconds();
+    for(int index = 0; index < rays_count; index += 1)
+    {
+        Hit hit = intersect_world(rays[index], world);
+        distance_sum += hit.distance < 1e30f ? hit.distance : 0.0f;
+    }
+    double seconds = get_time_seconds() - start;
+
+    hit_distance_sum += distance_sum;
+
+    return (1e9 * seconds) / rays_count;
+}
+
+static bool measure_intersections(SceneResult* result, World* world, Camera* camera, const BenchSettings* settings)
+{
+    int pixels_count = settings->dimensions.x * settings->dimensions.y;
+
+    Ray* primary_rays = malloc(sizeof(Ray) * pixels_count);
+    Ray* secondary_rays = malloc(sizeof(Ray) * pixels_count);
+    if(!primary_rays || !secondary_rays)
+    {
+        free(primary_rays);
+        free(secondary_rays);
+        return false;
+    }
+
+    Film film = film_create(camera, settings->dimensions);
+
+    for(int y = 0; y < settings->dimensions.y; y += 1)
+    {
+        for(int x = 0; x < settings->dimensions.x; x += 1)
+        {
+            int pixel_index = (settings->dimensions.x * y) + x;
+            Sampler sampler;
+            sampler_start(&sampler, SAMPLER_TYPE_RANDOM, settings->seed, pixel_index, 0);
+            primary_rays[pixel_index] = film_generate_ray(&film, x, y, &sampler);
+        }
+    }
+
+    RandomGenerator generator;
+    random_seed(&generator, settings->seed);
+
+    int secondary_rays_count = 0;
+
+    for(int index = 0; index < pixels_count; index += 1)
+    {
+        Ray ray = primary_rays[index];
+        Hit hit = intersect_world(ray, world);
+        if(!hit.material_index)
+        {
+            continue;
+        }
+
+        Float3 direction = random_direction(&generator);
+        if(float3_dot(direction, hit.normal) < 0.0f)
+        {
+            direction = float3_negate(direction);
+        }
+
+        Ray bounce;
+        bounce.origin = float3_add(float3_multiply(hit.distance, ray.direction), ray.origin);
+        bounce.direction = direction;
+        secondary_rays[secondary_rays_count] = bounce;
+        secondary_rays_count += 1;
+    }
+
+    result->primary_nanoseconds = time_intersections(primary_rays, pixels_count, world);
+    result->secondary_nanoseconds = time_intersections(secondary_rays, secondary_rays_count, world);
+    result->secondary_rays_count = secondary_rays_count;
+
+    free(primary_rays);
+    free(secondary_rays);
+
+    return true;
+}
+
+static bool render(SceneResult* result, RenderCounters* thread_counters, World* world, Camera* camera, ThreadPool* pool, const BenchSettings* settings)
+{
+    AccumulationBuffer accumulation;
+    bool accumulation_created = accumulation_buffer_create(&accumulation, settings->dimensions, NULL);
+
+    TileSchedule schedule;
+    Int2 tile_dimensions = {32, 32};
+    bool schedule_created = tile_schedule_create(&schedule, settings->dimensions, tile_dimensions, 1, NULL);
+
+    if(!accumulation_created || !schedule_created)
+    {
+        tile_schedule_destroy(&schedule);
+        accumulation_buffer_destroy(&accumulation);
+        return false;
+    }
+
+    schedule.accumulation = &accumulation;
+    schedule.camera = camera;
+    schedule.thread_counters = thread_counters;
+    schedule.thread_counters_count = settings->threads_count;
+    schedule.world = world;
+    schedule.seed = settings->seed;
+    schedule.integrator = settings->integrator;
+    schedule.sampler_type = SAMPLER_TYPE_SOBOL;
+    schedule.max_depth = 16;
+    schedule.roulette_depth = 3;
+    schedule.samples_per_pixel = settings->samples_per_pixel;
+
+    tile_schedule_restart(&schedule);
+
+    double start = get_time_seconds();
+
+    for(int thread_index = 0;
+            thread_index < settings->threads_count - 1;
+            thread_index += 1)
+    {
+        Task task =
+        {
+            .call = render_tiles,
+            .parameter = &schedule,
+        };
+        thread_pool_add_task(pool, task);
+    }
+
+    render_tiles(&schedule);
+
+    thread_pool_wait_all(pool);
+
+    result->wall_seconds = get_time_seconds() - start;
+
+    for(int thread_index = 0; thread_index < settings->threads_count; thread_index += 1)
+    {
+        RenderCounters* counters = &thread_counters[thread_index];
+        result->closest_hit_rays += counters->closest_hit_rays;
+        result->primary_rays += counters->primary_rays;
+        result->shadow_rays += counters->shadow_rays;
+    }
+
+    tile_schedule_destroy(&schedule);
+    accumulation_buffer_destroy(&accumulation);
+
+    return true;
+}
+
+static bool run_scene(SceneResult* result, RenderCounters* thread_counters, const BenchScene* scene, ThreadPool* pool, const BenchSettings* settings)
+{
+    memset(result, 0, sizeof(*result));
+    memset(thread_counters, 0, sizeof(RenderCounters) * settings->threads_count);
+
+    World world;
+    world_create(&world, NULL);
+
+    Camera camera;
+    double build_start = get_time_seconds();
+    bool built = scene->create(&world, &camera);
+    result->build_seconds = get_time_seconds() - build_start;
+    result->primitives_count = world.primitives_count + world.planes_count;
+
+    bool succeeded = built
+        && render(result, thread_counters, &world, &camera, pool, settings)
+        && measure_intersections(result, &world, &camera, settings);
+
+    world_destroy(&world);
+
+    return succeeded;
+}
+
+static void write_scene_json(FILE* file, const BenchScene* scene, const SceneResult* result, const RenderCounters* thread_counters, const BenchSettings* settings)
+{
+    uint64_t rays = result->closest_hit_rays + result->shadow_rays;
+
+    fprintf(file, "    {\n");
+    fprintf(file, "      \"name\": \"%s\",\n", scene->name);
+    fprintf(file, "      \"primitives\": %i,\n", result->primitives_count);
+    fprintf(file, "      \"build_seconds\": %.6f,\n", result->build_seconds);
+    fprintf(file, "      \"wall_seconds\": %.6f,\n", result->wall_seconds);
+    fprintf(file, "      \"primary_rays\": %llu,\n", (unsigned long long) result->primary_rays);
+    fprintf(file, "      \"closest_hit_rays\": %llu,\n", (unsigned long long) result->closest_hit_rays);
+    fprintf(file, "      \"shadow_rays\": %llu,\n", (unsigned long long) result->shadow_rays);
+    fprintf(file, "      \"total_rays\": %llu,\n", (unsigned long long) rays);
+    fprintf(file, "      \"primary_rays_per_second\": %.1f,\n", result->primary_rays / result->wall_seconds);
+    fprintf(file, "      \"total_rays_per_second\": %.1f,\n", rays / result->wall_seconds);
+    fprintf(file, "      \"ns_per_primary_intersection\": %.2f,\n", result->primary_nanoseconds);
+    fprintf(file, "      \"ns_per_secondary_intersection\": %.2f,\n", result->secondary_nanoseconds);
+    fprintf(file, "      \"secondary_intersections\": %i,\n", result->secondary_rays_count);
+    fprintf(file, "      \"threads\": [\n");
+
+    for(int thread_index = 0; thread_index < settings->threads_count; thread_index += 1)
+    {
+        const RenderCounters* counters = &thread_counters[thread_index];
+        uint64_t thread_rays = counters->closest_hit_rays + counters->shadow_rays;
+        fprintf(file, "        {\"tiles\": %i, \"rays\": %llu, \"busy_seconds\": %.6f, \"utilisation\": %.4f}%s\n",
+            counters->tiles_count, (unsigned long long) thread_rays, counters->busy_seconds,
+            counters->busy_seconds / result->wall_seconds,
+            thread_index + 1 < settings->threads_count ? "," : "");
+    }
+
+    fprintf(file, "      ]\n");
+    fprintf(file, "    }");
+}
+
+int main(int argc, const char** argv)
+{
+    BenchScene scenes[] =
+    {
+        {"demo", scene_create_demo},
+        {"mesh", create_mesh_scene},
+        {"spheres", create_spheres_scene},
+    };
+    const int scenes_count = sizeof(scenes) / sizeof(*scenes);
+
+    BenchSettings settings;
+    settings.dimensions.x = 640;
+    settings.dimensions.y = 360;
+    settings.seed = 1;
+    settings.integrator = INTEGRATOR_MEGAKERNEL;
+    settings.samples_per_pixel = 4;
+    settings.threads_count = get_logical_core_count();
+
+    const char* output_path = NULL;
+    const char* only_scene = NULL;
+
+    for(int arg_index = 1; arg_index < argc; arg_index += 1)
+    {
+        if(strcmp(argv[arg_index], "--integrator") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(strcmp(argv[arg_index], "wavefront") == 0)
+            {
+                settings.integrator = INTEGRATOR_WAVEFRONT;
+            }
+            else if(strcmp(argv[arg_index], "megakernel") == 0)
+            {
+                settings.integrator = INTEGRATOR_MEGAKERNEL;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown integrator %s.\n", argv[arg_index]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--samples") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            settings.samples_per_pixel = atoi(argv[arg_index]);
+            if(settings.samples_per_pixel <= 0)
+            {
+                fprintf(stderr, "Samples per pixel must be a positive number.\n");
+                return 1;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--size") == 0 && arg_index + 2 < argc)
+        {
+            settings.dimensions.x = atoi(argv[arg_index + 1]);
+            settings.dimensions.y = atoi(argv[arg_index + 2]);
+            arg_index += 2;
+            if(settings.dimensions.x <= 0 || settings.dimensions.y <= 0)
+            {
+                fprintf(stderr, "Image width and height must be positive numbers.\n");
+                return 1;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--seed") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            settings.seed = strtoull(argv[arg_index], NULL, 10);
+        }
+        else if(strcmp(argv[arg_index], "--scene") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            only_scene = argv[arg_index];
+        }
+        else if(strcmp(argv[arg_index], "--output") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            output_path = argv[arg_index];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s.\n", argv[arg_index]);
+            return 1;
+        }
+    }
+
+    FILE* file = stdout;
+    if(output_path)
+    {
+        file = fopen(output_path, "w");
+        if(!file)
+        {
+            fprintf(stderr, "Couldn't open %s.\n", output_path);
+            return 1;
+        }
+    }
+
+    ThreadPool* pool = thread_pool_create(NULL, settings.threads_count - 1, NULL);
+    RenderCounters* thread_counters = malloc(sizeof(RenderCounters) * settings.threads_count);
+    if(!pool || !thread_counters)
+    {
+        fprintf(stderr, "Couldn't create the thread pool.\n");
+        if(pool)
+        {
+            thread_pool_destroy(pool);
+        }
+        free(thread_counters);
+        return 1;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"integrator\": \"%s\",\n", settings.integrator == INTEGRATOR_WAVEFRONT ? "wavefront" : "megakernel");
+    fprintf(file, "  \"width\": %i,\n", settings.dimensions.x);
+    fprintf(file, "  \"height\": %i,\n", settings.dimensions.y);
+    fprintf(file, "  \"samples_per_pixel\": %i,\n", settings.samples_per_pixel);
+    fprintf(file, "  \"seed\": %llu,\n", (unsigned long long) settings.seed);
+    fprintf(file, "  \"threads\": %i,\n", settings.threads_count);
+    fprintf(file, "  \"scenes\": [\n");
+
+    bool all_succeeded = true;
+    int written_count = 0;
+
+    for(int scene_index = 0; scene_index < scenes_count; scene_index += 1)
+    {
+        const BenchScene* scene = &scenes[scene_index];
+        if(only_scene && strcmp(only_scene, scene->name) != 0)
+        {
+            continue;
+        }
+
+        fprintf(stderr, "Rendering the %s scene.\n", scene->name);
+
+        SceneResult result;
+        if(!run_scene(&result, thread_counters, scene, pool, &settings))
+        {
+            fprintf(stderr, "Failed to render the %s scene.\n", scene->name);
+            all_succeeded = false;
+            continue;
+        }
+
+        if(written_count > 0)
+        {
+            fprintf(file, ",\n");
+        }
+        write_scene_json(file, scene, &result, thread_counters, &settings);
+        written_count += 1;
+    }
+
+    fprintf(file, "\n  ]\n");
+    fprintf(file, "}\n");
+
+    if(output_path)
+    {
+        fclose(file);
+    }
+
+    free(thread_counters);
+    thread_pool_destroy(pool);
+
+    return all_succeeded ? 0 : 1;
+}
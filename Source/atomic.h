@@ -13,12 +13,25 @@ typedef struct AtomicInt
     volatile long value;
 } AtomicInt;
 
+typedef struct AtomicPointer
+{
+    void* volatile value;
+} AtomicPointer;
+
 bool atomic_bool_load(AtomicBool* b);
 void atomic_bool_store(AtomicBool* b, bool value);
 
 long atomic_int_add(AtomicInt* augend, long addend);
+bool atomic_int_compare_exchange(AtomicInt* i, long expected, long desired);
 long atomic_int_load(AtomicInt* i);
 void atomic_int_store(AtomicInt* i, long value);
 long atomic_int_subtract(AtomicInt* minuend, long subtrahend);
 
+void* atomic_pointer_load(AtomicPointer* p);
+void atomic_pointer_store(AtomicPointer* p, void* value);
+
+// Tells the processor the thread is spinning on a lock or a retry loop, so it
+// can ease off and leave more to a sibling hardware thread.
+void atomic_pause(void);
+
 #endif // ATOMIC_H_
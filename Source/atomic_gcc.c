@@ -16,6 +16,11 @@ long atomic_int_add(AtomicInt* augend, long addend)
     return __atomic_add_fetch(&augend->value, addend, __ATOMIC_SEQ_CST);
 }
 
+bool atomic_int_compare_exchange(AtomicInt* i, long expected, long desired)
+{
+    return __atomic_compare_exchange_n(&i->value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
 long atomic_int_load(AtomicInt* i)
 {
     return __atomic_load_n(&i->value, __ATOMIC_SEQ_CST);
@@ -30,3 +35,24 @@ long atomic_int_subtract(AtomicInt* minuend, long subtrahend)
 {
     return __atomic_sub_fetch(&minuend->value, subtrahend, __ATOMIC_SEQ_CST);
 }
+
+
+void* atomic_pointer_load(AtomicPointer* p)
+{
+    return __atomic_load_n(&p->value, __ATOMIC_SEQ_CST);
+}
+
+void atomic_pointer_store(AtomicPointer* p, void* value)
+{
+    __atomic_store_n(&p->value, value, __ATOMIC_SEQ_CST);
+}
+
+
+void atomic_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
@@ -8,7 +8,7 @@
 
 bool atomic_bool_load(AtomicBool* b)
 {
-    return _InterlockedExchange((volatile long*) &b->value, 0l);
+    return _InterlockedOr((volatile long*) &b->value, 0l);
 }
 
 void atomic_bool_store(AtomicBool* b, bool value)
@@ -23,6 +23,11 @@ long atomic_int_add(AtomicInt* augend, long addend)
     return contents + addend;
 }
 
+bool atomic_int_compare_exchange(AtomicInt* i, long expected, long desired)
+{
+    return _InterlockedCompareExchange((volatile long*) &i->value, desired, expected) == expected;
+}
+
 long atomic_int_load(AtomicInt* i)
 {
     return _InterlockedOr((volatile long*) &i->value, 0l);
@@ -37,4 +42,21 @@ long atomic_int_subtract(AtomicInt* minuend, long subtrahend)
 {
     long contents = _InterlockedExchangeAdd((volatile long*) &minuend->value, -subtrahend);
     return contents - subtrahend;
-}
\ No newline at end of file
+}
+
+
+void* atomic_pointer_load(AtomicPointer* p)
+{
+    return _InterlockedCompareExchangePointer((void* volatile*) &p->value, NULL, NULL);
+}
+
+void atomic_pointer_store(AtomicPointer* p, void* value)
+{
+    _InterlockedExchangePointer((void* volatile*) &p->value, value);
+}
+
+
+void atomic_pause(void)
+{
+    YieldProcessor();
+}
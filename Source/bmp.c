@@ -35,17 +35,18 @@ typedef enum Compression
     COMPRESSION_NONE = 0,
 } Compression;
 
-static unsigned int pad_multiple_of_four(unsigned int x)
+// Rows are written straight from the pixels, which needs no padding since
+// every row of 32-bit pixels is already a multiple of four bytes long.
+bool bmp_write_file(const char* path, const uint8_t* pixels, int width, int height)
 {
-    return (x + 3) & ~0x3;
-}
+    uint32_t bytes_per_pixel = 4;
+    uint64_t pixel_data_size = (uint64_t) bytes_per_pixel * (uint64_t) width * (uint64_t) height;
+    uint64_t headers_size = sizeof(BmpFileHeader) + sizeof(BmpInfoHeader);
 
-bool bmp_write_file(const char* path, const uint8_t* pixels, int width, int height, Allocator* allocator)
-{
-    unsigned int bytes_per_pixel = 4;
-    unsigned int padded_width = pad_multiple_of_four(width);
-    unsigned int pixel_data_size = bytes_per_pixel * padded_width * height;
-    int row_padding = padded_width - width;
+    if(headers_size + pixel_data_size > UINT32_MAX)
+    {
+        return false;
+    }
 
     BmpInfoHeader info;
     info.size = sizeof(info);
@@ -54,7 +55,7 @@ bool bmp_write_file(const char* path, const uint8_t* pixels, int width, int heig
     info.planes = 1;
     info.bits_per_pixel = 8 * bytes_per_pixel;
     info.compression = COMPRESSION_NONE;
-    info.image_size = width * height * info.bits_per_pixel;
+    info.image_size = (uint32_t) pixel_data_size;
     info.pixels_per_meter_x = 0;
     info.pixels_per_meter_y = 0;
     info.colours_used = 0;
@@ -63,33 +64,20 @@ bool bmp_write_file(const char* path, const uint8_t* pixels, int width, int heig
     BmpFileHeader header;
     header.type[0] = 'B';
     header.type[1] = 'M';
-    header.size = sizeof(header) + sizeof(info) + pixel_data_size;
+    header.size = (uint32_t) (headers_size + pixel_data_size);
     header.reserved1 = 0;
     header.reserved2 = 0;
-    header.offset = sizeof(header) + sizeof(info);
+    header.offset = (uint32_t) headers_size;
 
-    // Create the file in-memory;
-    uint64_t file_size = header.size;
-    uint8_t* file_contents = (uint8_t*) allocate(allocator, file_size);
-    uint8_t* hand = file_contents;
-
-    copy_memory(hand, &header, sizeof(header));
-    hand += sizeof(header);
-    copy_memory(hand, &info, sizeof(info));
-    hand += sizeof(info);
-
-    for(int i = 0; i < height; ++i)
+    FileWriter writer;
+    if(!file_writer_open(&writer, path))
     {
-        uint64_t row_size = bytes_per_pixel * width;
-        copy_memory(hand, &pixels[bytes_per_pixel * width * i], row_size);
-        hand += row_size;
-        zero_memory(hand, row_padding);
-        hand += row_padding;
+        return false;
     }
 
-    save_whole_file(path, file_contents, file_size);
-
-    deallocate(allocator, file_contents, file_size);
+    file_writer_write(&writer, &header, sizeof(header));
+    file_writer_write(&writer, &info, sizeof(info));
+    file_writer_write(&writer, pixels, pixel_data_size);
 
-    return true;
+    return file_writer_close(&writer);
 }
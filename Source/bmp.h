@@ -3,10 +3,11 @@
 #ifndef BMP_H_
 #define BMP_H_
 
-#include "memory.h"
-
 #include <stdbool.h>
+#include <stdint.h>
 
-bool bmp_write_file(const char* path, const uint8_t* pixels, int width, int height, Allocator* allocator);
+// Sizes in the headers are 32-bit, so an image over about a billion pixels
+// can't be written and this fails. Use a float map for renders that big.
+bool bmp_write_file(const char* path, const uint8_t* pixels, int width, int height);
 
 #endif // BMP_H_
@@ -0,0 +1,125 @@
+#include "bsdf.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+static float glossy_exponent(float glossiness)
+{
+    float roughness = 1.0f - glossiness;
+    return 2.0f / ((roughness * roughness) + 0.0001f);
+}
+
+static Float3 mirror(Float3 outgoing, Float3 normal)
+{
+    return float3_subtract(float3_multiply(2.0f * float3_dot(outgoing, normal), normal), outgoing);
+}
+
+static Float3 from_basis(Float3 axis, float x, float y, float z)
+{
+    Float3 tangent;
+    Float3 bitangent;
+    float3_make_basis(axis, &tangent, &bitangent);
+
+    Float3 result = float3_multiply(z, axis);
+    result = float3_add(result, float3_multiply(x, tangent));
+    result = float3_add(result, float3_multiply(y, bitangent));
+    return result;
+}
+
+static Float3 sample_cosine_hemisphere(Float3 normal, Float2 u)
+{
+    float r = sqrtf(u.x);
+    float phi = 2.0f * (float) M_PI * u.y;
+    float z = sqrtf(fmaxf(1.0f - u.x, 0.0f));
+    return from_basis(normal, r * cosf(phi), r * sinf(phi), z);
+}
+
+static Float3 sample_phong_lobe(Float3 axis, float exponent, Float2 u)
+{
+    float cos_alpha = powf(u.x, 1.0f / (exponent + 1.0f));
+    float sin_alpha = sqrtf(fmaxf(1.0f - (cos_alpha * cos_alpha), 0.0f));
+    float phi = 2.0f * (float) M_PI * u.y;
+    return from_basis(axis, sin_alpha * cosf(phi), sin_alpha * sinf(phi), cos_alpha);
+}
+
+Float3 bsdf_evaluate(Material material, Float3 normal, Float3 outgoing, Float3 incoming)
+{
+    float cos_incoming = float3_dot(incoming, normal);
+    float cos_outgoing = float3_dot(outgoing, normal);
+    if(cos_incoming <= 0.0f || cos_outgoing <= 0.0f)
+    {
+        return float3_zero;
+    }
+
+    float diffuse = (1.0f - material.glossiness) / (float) M_PI;
+
+    float glossy = 0.0f;
+    if(material.glossiness > 0.0f)
+    {
+        float exponent = glossy_exponent(material.glossiness);
+        float cos_alpha = float3_dot(incoming, mirror(outgoing, normal));
+        if(cos_alpha > 0.0f)
+        {
+            glossy = material.glossiness * (exponent + 2.0f) / (2.0f * (float) M_PI) * powf(cos_alpha, exponent);
+        }
+    }
+
+    return float3_multiply(diffuse + glossy, material.reflectance);
+}
+
+float bsdf_pdf(Material material, Float3 normal, Float3 outgoing, Float3 incoming)
+{
+    float cos_incoming = float3_dot(incoming, normal);
+    if(cos_incoming <= 0.0f || float3_dot(outgoing, normal) <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float pdf = (1.0f - material.glossiness) * cos_incoming / (float) M_PI;
+
+    if(material.glossiness > 0.0f)
+    {
+        float exponent = glossy_exponent(material.glossiness);
+        float cos_alpha = float3_dot(incoming, mirror(outgoing, normal));
+        if(cos_alpha > 0.0f)
+        {
+            pdf += material.glossiness * (exponent + 1.0f) / (2.0f * (float) M_PI) * powf(cos_alpha, exponent);
+        }
+    }
+
+    return pdf;
+}
+
+BsdfSample bsdf_sample(Material material, Float3 normal, Float3 outgoing, float lobe_sample, Float2 direction_sample)
+{
+    BsdfSample result;
+    result.valid = false;
+
+    if(float3_dot(outgoing, normal) <= 0.0f)
+    {
+        return result;
+    }
+
+    if(lobe_sample < material.glossiness)
+    {
+        float exponent = glossy_exponent(material.glossiness);
+        result.incoming = sample_phong_lobe(mirror(outgoing, normal), exponent, direction_sample);
+    }
+    else
+    {
+        result.incoming = sample_cosine_hemisphere(normal, direction_sample);
+    }
+
+    float cos_incoming = float3_dot(result.incoming, normal);
+    result.pdf = bsdf_pdf(material, normal, outgoing, result.incoming);
+    if(cos_incoming <= 0.0f || result.pdf <= 0.0f)
+    {
+        return result;
+    }
+
+    Float3 f = bsdf_evaluate(material, normal, outgoing, result.incoming);
+    result.weight = float3_multiply(cos_incoming / result.pdf, f);
+    result.valid = true;
+
+    return result;
+}
@@ -0,0 +1,35 @@
+// Bidirectional Scattering Distribution Function
+//
+// A material scatters light with a mix of two lobes: a Lambertian diffuse
+// lobe and a glossy lobe around the mirror direction, the normalised Phong
+// lobe. Glossiness is the weight of the glossy lobe, and it also narrows that
+// lobe as it approaches one. Both lobes are tinted by the reflectance.
+//
+// Sampling picks a lobe in proportion to its weight, then draws a direction
+// from it. The returned pdf is that of the whole mixture, so it matches what
+// bsdf_pdf gives for the same pair of directions.
+//
+// Directions all point away from the surface: outgoing towards the viewer and
+// incoming towards the light.
+
+#ifndef BSDF_H_
+#define BSDF_H_
+
+#include "vector_math.h"
+#include "world.h"
+
+#include <stdbool.h>
+
+typedef struct BsdfSample
+{
+    Float3 incoming;
+    Float3 weight;
+    float pdf;
+    bool valid;
+} BsdfSample;
+
+Float3 bsdf_evaluate(Material material, Float3 normal, Float3 outgoing, Float3 incoming);
+float bsdf_pdf(Material material, Float3 normal, Float3 outgoing, Float3 incoming);
+BsdfSample bsdf_sample(Material material, Float3 normal, Float3 outgoing, float lobe_sample, Float2 direction_sample);
+
+#endif // BSDF_H_
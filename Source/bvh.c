@@ -0,0 +1,413 @@
+#include "bvh.h"
+
+#include "assert.h"
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+
+#define BIN_COUNT 16
+
+static const float traversal_cost = 1.0f;
+static const float intersection_cost = 1.0f;
+
+typedef struct Bin
+{
+    Aabb bounds;
+    int count;
+} Bin;
+
+typedef struct BuildEntry
+{
+    int node_index;
+    int first;
+    int count;
+    int depth;
+} BuildEntry;
+
+
+Aabb aabb_empty(void)
+{
+    Aabb result;
+    result.min = (Float3){FLT_MAX, FLT_MAX, FLT_MAX};
+    result.max = (Float3){-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    return result;
+}
+
+Aabb aabb_merge(Aabb a, Aabb b)
+{
+    Aabb result;
+    result.min.x = fminf(a.min.x, b.min.x);
+    result.min.y = fminf(a.min.y, b.min.y);
+    result.min.z = fminf(a.min.z, b.min.z);
+    result.max.x = fmaxf(a.max.x, b.max.x);
+    result.max.y = fmaxf(a.max.y, b.max.y);
+    result.max.z = fmaxf(a.max.z, b.max.z);
+    return result;
+}
+
+Aabb aabb_merge_point(Aabb box, Float3 point)
+{
+    Aabb result;
+    result.min.x = fminf(box.min.x, point.x);
+    result.min.y = fminf(box.min.y, point.y);
+    result.min.z = fminf(box.min.z, point.z);
+    result.max.x = fmaxf(box.max.x, point.x);
+    result.max.y = fmaxf(box.max.y, point.y);
+    result.max.z = fmaxf(box.max.z, point.z);
+    return result;
+}
+
+float aabb_surface_area(Aabb box)
+{
+    Float3 extent = float3_subtract(box.max, box.min);
+    if(extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f)
+    {
+        return 0.0f;
+    }
+    return 2.0f * ((extent.x * extent.y) + (extent.y * extent.z) + (extent.z * extent.x));
+}
+
+// Slab test. The inverse direction components may be infinite for axis-aligned
+// rays, which the comparisons handle without special cases.
+bool aabb_intersect_ray(Aabb box, Float3 origin, Float3 inverse_direction, float t_max, float* t_entry)
+{
+    float t_near = 0.0f;
+    float t_far = t_max;
+
+    for(int axis = 0; axis < 3; axis += 1)
+    {
+        float t0 = (box.min.e[axis] - origin.e[axis]) * inverse_direction.e[axis];
+        float t1 = (box.max.e[axis] - origin.e[axis]) * inverse_direction.e[axis];
+        if(t0 > t1)
+        {
+            float temp = t0;
+            t0 = t1;
+            t1 = temp;
+        }
+        t_near = t0 > t_near ? t0 : t_near;
+        t_far = t1 < t_far ? t1 : t_far;
+    }
+
+    *t_entry = t_near;
+
+    return t_near <= t_far;
+}
+
+
+static Float3 aabb_centroid(Aabb box)
+{
+    return float3_multiply(0.5f, float3_add(box.min, box.max));
+}
+
+static int get_bin_index(float centroid, float min, float scale)
+{
+    int bin = (int) ((centroid - min) * scale);
+    if(bin < 0)
+    {
+        return 0;
+    }
+    if(bin > BIN_COUNT - 1)
+    {
+        return BIN_COUNT - 1;
+    }
+    return bin;
+}
+
+static void make_leaf(BvhNode* node, int first, int count)
+{
+    node->first = first;
+    node->count = count;
+}
+
+bool bvh_build(Bvh* bvh, const Aabb* primitive_bounds, int primitives_count, Allocator* allocator)
+{
+    bvh->allocator = allocator;
+    bvh->primitives_count = primitives_count;
+    bvh->nodes_count = 0;
+    bvh->nodes_cap = primitives_count > 0 ? 2 * primitives_count : 1;
+    bvh->nodes = allocate_aligned(allocator, sizeof(BvhNode) * bvh->nodes_cap, CACHE_LINE_SIZE);
+    bvh->primitive_indices = allocate(allocator, sizeof(int) * (primitives_count > 0 ? primitives_count : 1));
+
+    if(!bvh->nodes || !bvh->primitive_indices)
+    {
+        bvh_destroy(bvh);
+        return false;
+    }
+
+    BvhNode* root = &bvh->nodes[0];
+    root->bounds = aabb_empty();
+    make_leaf(root, 0, 0);
+    bvh->nodes_count = 1;
+
+    if(primitives_count == 0)
+    {
+        return true;
+    }
+
+    for(int index = 0; index < primitives_count; index += 1)
+    {
+        bvh->primitive_indices[index] = index;
+    }
+
+    int* indices = bvh->primitive_indices;
+
+    BuildEntry stack[BVH_MAX_DEPTH];
+    int stack_count = 0;
+    stack[stack_count] = (BuildEntry){0, 0, primitives_count, 0};
+    stack_count += 1;
+
+    while(stack_count > 0)
+    {
+        stack_count -= 1;
+        BuildEntry entry = stack[stack_count];
+        BvhNode* node = &bvh->nodes[entry.node_index];
+
+        Aabb bounds = aabb_empty();
+        Aabb centroid_bounds = aabb_empty();
+        for(int i = entry.first; i < entry.first + entry.count; i += 1)
+        {
+            Aabb box = primitive_bounds[indices[i]];
+            bounds = aabb_merge(bounds, box);
+            centroid_bounds = aabb_merge_point(centroid_bounds, aabb_centroid(box));
+        }
+        node->bounds = bounds;
+
+        if(entry.count == 1 || entry.depth >= BVH_MAX_DEPTH - 2)
+        {
+            make_leaf(node, entry.first, entry.count);
+            continue;
+        }
+
+        // Find the cheapest binned split over all three axes.
+        float best_cost = FLT_MAX;
+        int best_axis = -1;
+        int best_split = 0;
+
+        for(int axis = 0; axis < 3; axis += 1)
+        {
+            float min = centroid_bounds.min.e[axis];
+            float extent = centroid_bounds.max.e[axis] - min;
+            if(extent <= 0.0f)
+            {
+                continue;
+            }
+            float scale = BIN_COUNT / extent;
+
+            Bin bins[BIN_COUNT];
+            for(int bin = 0; bin < BIN_COUNT; bin += 1)
+            {
+                bins[bin].bounds = aabb_empty();
+                bins[bin].count = 0;
+            }
+
+            for(int i = entry.first; i < entry.first + entry.count; i += 1)
+            {
+                Aabb box = primitive_bounds[indices[i]];
+                int bin = get_bin_index(aabb_centroid(box).e[axis], min, scale);
+                bins[bin].bounds = aabb_merge(bins[bin].bounds, box);
+                bins[bin].count += 1;
+            }
+
+            // Sweep from the right to accumulate the area and count of every
+            // suffix, then sweep from the left evaluating each split plane.
+            float right_areas[BIN_COUNT];
+            int right_counts[BIN_COUNT];
+            Aabb right_bounds = aabb_empty();
+            int right_count = 0;
+            for(int bin = BIN_COUNT - 1; bin > 0; bin -= 1)
+            {
+                right_bounds = aabb_merge(right_bounds, bins[bin].bounds);
+                right_count += bins[bin].count;
+                right_areas[bin] = aabb_surface_area(right_bounds);
+                right_counts[bin] = right_count;
+            }
+
+            Aabb left_bounds = aabb_empty();
+            int left_count = 0;
+            for(int split = 1; split < BIN_COUNT; split += 1)
+            {
+                left_bounds = aabb_merge(left_bounds, bins[split - 1].bounds);
+                left_count += bins[split - 1].count;
+                if(left_count == 0 || right_counts[split] == 0)
+                {
+                    continue;
+                }
+                float cost = (aabb_surface_area(left_bounds) * left_count) + (right_areas[split] * right_counts[split]);
+                if(cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = split;
+                }
+            }
+        }
+
+        float parent_area = aabb_surface_area(bounds);
+        float leaf_cost = intersection_cost * entry.count;
+        float split_cost = traversal_cost;
+        if(parent_area > 0.0f)
+        {
+            split_cost += intersection_cost * best_cost / parent_area;
+        }
+
+        if(best_axis == -1 || (entry.count <= BVH_MAX_LEAF_PRIMITIVES && leaf_cost <= split_cost))
+        {
+            make_leaf(node, entry.first, entry.count);
+            continue;
+        }
+
+        // Partition the primitive indices about the chosen split plane.
+        float min = centroid_bounds.min.e[best_axis];
+        float scale = BIN_COUNT / (centroid_bounds.max.e[best_axis] - min);
+        int left = entry.first;
+        int right = entry.first + entry.count - 1;
+        while(left <= right)
+        {
+            Aabb box = primitive_bounds[indices[left]];
+            int bin = get_bin_index(aabb_centroid(box).e[best_axis], min, scale);
+            if(bin < best_split)
+            {
+                left += 1;
+            }
+            else
+            {
+                int temp = indices[left];
+                indices[left] = indices[right];
+                indices[right] = temp;
+                right -= 1;
+            }
+        }
+
+        int left_count = left - entry.first;
+        ASSERT(left_count > 0 && left_count < entry.count);
+        int children = bvh->nodes_count + (bvh->nodes_count & 1);
+        ASSERT(children + 2 <= bvh->nodes_cap);
+        bvh->nodes_count = children + 2;
+        node->first = children;
+        node->count = 0;
+
+        ASSERT(stack_count + 2 <= BVH_MAX_DEPTH);
+        stack[stack_count] = (BuildEntry){children + 1, left, entry.count - left_count, entry.depth + 1};
+        stack_count += 1;
+        stack[stack_count] = (BuildEntry){children, entry.first, left_count, entry.depth + 1};
+        stack_count += 1;
+    }
+
+    return true;
+}
+
+// Copies a hierarchy that was built earlier, such as one saved in a scene
+// cache, instead of building it again.
+bool bvh_load(Bvh* bvh, const BvhNode* nodes, int nodes_count, const int* primitive_indices, int primitives_count, Allocator* allocator)
+{
+    ASSERT(nodes_count > 0);
+
+    bvh->allocator = allocator;
+    bvh->primitives_count = primitives_count;
+    bvh->nodes_count = nodes_count;
+    bvh->nodes_cap = nodes_count;
+    bvh->nodes = allocate_aligned(allocator, sizeof(BvhNode) * nodes_count, CACHE_LINE_SIZE);
+    bvh->primitive_indices = allocate(allocator, sizeof(int) * (primitives_count > 0 ? primitives_count : 1));
+
+    if(!bvh->nodes || !bvh->primitive_indices)
+    {
+        bvh_destroy(bvh);
+        return false;
+    }
+
+    copy_memory(bvh->nodes, nodes, sizeof(BvhNode) * nodes_count);
+    copy_memory(bvh->primitive_indices, primitive_indices, sizeof(int) * primitives_count);
+
+    return true;
+}
+
+void bvh_destroy(Bvh* bvh)
+{
+    if(bvh->nodes)
+    {
+        deallocate_aligned(bvh->allocator, bvh->nodes, sizeof(BvhNode) * bvh->nodes_cap, CACHE_LINE_SIZE);
+        bvh->nodes = NULL;
+    }
+    if(bvh->primitive_indices)
+    {
+        deallocate(bvh->allocator, bvh->primitive_indices, sizeof(int) * (bvh->primitives_count > 0 ? bvh->primitives_count : 1));
+        bvh->primitive_indices = NULL;
+    }
+    bvh->nodes_count = 0;
+}
+
+BvhStatistics bvh_compute_statistics(const Bvh* bvh)
+{
+    BvhStatistics statistics = {0};
+    statistics.min_leaf_size = bvh->primitives_count;
+
+    if(bvh->nodes_count == 0)
+    {
+        return statistics;
+    }
+
+    float root_area = aabb_surface_area(bvh->nodes[0].bounds);
+    int total_leaf_depth = 0;
+    int total_leaf_size = 0;
+
+    int node_stack[BVH_MAX_DEPTH];
+    int depth_stack[BVH_MAX_DEPTH];
+    int stack_count = 1;
+    node_stack[0] = 0;
+    depth_stack[0] = 1;
+
+    while(stack_count > 0)
+    {
+        stack_count -= 1;
+        const BvhNode* node = &bvh->nodes[node_stack[stack_count]];
+        int depth = depth_stack[stack_count];
+        statistics.nodes_count += 1;
+
+        if(depth > statistics.depth)
+        {
+            statistics.depth = depth;
+        }
+
+        float area_ratio = root_area > 0.0f ? aabb_surface_area(node->bounds) / root_area : 1.0f;
+
+        if(node->count > 0 || bvh->nodes_count == 1)
+        {
+            int size = node->count;
+            statistics.leaves_count += 1;
+            total_leaf_depth += depth;
+            total_leaf_size += size;
+            statistics.sah_cost += area_ratio * intersection_cost * size;
+
+            if(size < statistics.min_leaf_size)
+            {
+                statistics.min_leaf_size = size;
+            }
+            if(size > statistics.max_leaf_size)
+            {
+                statistics.max_leaf_size = size;
+            }
+
+            int bucket = size > BVH_MAX_LEAF_PRIMITIVES ? BVH_MAX_LEAF_PRIMITIVES : size - 1;
+            if(bucket >= 0)
+            {
+                statistics.leaf_size_histogram[bucket] += 1;
+            }
+        }
+        else
+        {
+            statistics.sah_cost += area_ratio * traversal_cost;
+
+            node_stack[stack_count] = node->first;
+            depth_stack[stack_count] = depth + 1;
+            node_stack[stack_count + 1] = node->first + 1;
+            depth_stack[stack_count + 1] = depth + 1;
+            stack_count += 2;
+        }
+    }
+
+    statistics.average_leaf_depth = total_leaf_depth / (float) statistics.leaves_count;
+    statistics.average_leaf_size = total_leaf_size / (float) statistics.leaves_count;
+
+    return statistics;
+}
@@ -0,0 +1,69 @@
+// Bounding Volume Hierarchy
+
+#ifndef BVH_H_
+#define BVH_H_
+
+#include "memory.h"
+#include "vector_math.h"
+
+#include <stdbool.h>
+
+#define BVH_MAX_DEPTH 64
+#define BVH_MAX_LEAF_PRIMITIVES 8
+
+typedef struct Aabb
+{
+    Float3 min;
+    Float3 max;
+} Aabb;
+
+// Interior nodes have a count of zero and their two children are stored
+// next to each other starting at index first. Leaf nodes reference the range
+// [first, first + count) of the primitive indices array.
+//
+// The nodes array starts on a cache line and children always start at an even
+// index, so both children of a node, which are tested together, share one
+// cache line. That leaves the node at index 1 unused when the root has
+// children.
+typedef struct BvhNode
+{
+    Aabb bounds;
+    int first;
+    int count;
+} BvhNode;
+
+typedef struct Bvh
+{
+    Allocator* allocator;
+    BvhNode* nodes;
+    int* primitive_indices;
+    int nodes_cap;
+    int nodes_count;
+    int primitives_count;
+} Bvh;
+
+typedef struct BvhStatistics
+{
+    int leaf_size_histogram[BVH_MAX_LEAF_PRIMITIVES + 1];
+    float average_leaf_depth;
+    float average_leaf_size;
+    float sah_cost;
+    int depth;
+    int leaves_count;
+    int max_leaf_size;
+    int min_leaf_size;
+    int nodes_count;
+} BvhStatistics;
+
+Aabb aabb_empty(void);
+Aabb aabb_merge(Aabb a, Aabb b);
+Aabb aabb_merge_point(Aabb box, Float3 point);
+float aabb_surface_area(Aabb box);
+bool aabb_intersect_ray(Aabb box, Float3 origin, Float3 inverse_direction, float t_max, float* t_entry);
+
+bool bvh_build(Bvh* bvh, const Aabb* primitive_bounds, int primitives_count, Allocator* allocator);
+bool bvh_load(Bvh* bvh, const BvhNode* nodes, int nodes_count, const int* primitive_indices, int primitives_count, Allocator* allocator);
+void bvh_destroy(Bvh* bvh);
+BvhStatistics bvh_compute_statistics(const Bvh* bvh);
+
+#endif // BVH_H_
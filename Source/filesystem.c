@@ -2,21 +2,83 @@
 
 #include <stdio.h>
 
-bool save_whole_file(const char* path, const void* contents, uint64_t bytes)
+// The contents are followed by a null terminator that isn't counted in bytes,
+// so text can be parsed in place. They're allocated bytes + 1 long.
+bool load_whole_file(const char* path, char** contents, uint64_t* bytes, Allocator* allocator)
 {
-    FILE* file = fopen(path, "wb");
+    FileStamp stamp;
+    if(!get_file_stamp(path, &stamp))
+    {
+        return false;
+    }
+
+    FILE* file = fopen(path, "rb");
     if(!file)
     {
         return false;
     }
 
-    uint64_t written = fwrite(contents, 1, bytes, file);
-    if(written != bytes)
+    char* buffer = allocate(allocator, stamp.bytes + 1);
+    if(!buffer)
     {
+        fclose(file);
         return false;
     }
 
+    uint64_t read = fread(buffer, 1, stamp.bytes, file);
     fclose(file);
 
+    if(read != stamp.bytes)
+    {
+        deallocate(allocator, buffer, stamp.bytes + 1);
+        return false;
+    }
+
+    buffer[read] = '\0';
+    *contents = buffer;
+    *bytes = read;
+
     return true;
 }
+
+bool save_whole_file(const char* path, const void* contents, uint64_t bytes)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file)
+    {
+        return false;
+    }
+
+    uint64_t written = fwrite(contents, 1, bytes, file);
+    int closed = fclose(file);
+
+    return written == bytes && closed == 0;
+}
+
+bool file_writer_open(FileWriter* writer, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    writer->handle = file;
+    writer->failed = !file;
+    return file != NULL;
+}
+
+void file_writer_write(FileWriter* writer, const void* contents, uint64_t bytes)
+{
+    if(!writer->failed)
+    {
+        uint64_t written = fwrite(contents, 1, bytes, writer->handle);
+        writer->failed = written != bytes;
+    }
+}
+
+bool file_writer_close(FileWriter* writer)
+{
+    if(writer->handle)
+    {
+        int closed = fclose(writer->handle);
+        writer->failed = writer->failed || closed != 0;
+        writer->handle = NULL;
+    }
+    return !writer->failed;
+}
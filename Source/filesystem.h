@@ -1,9 +1,48 @@
 #ifndef FILESYSTEM_H_
 #define FILESYSTEM_H_
 
+#include "memory.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
+// Enough to tell whether a file has changed since it was last looked at. The
+// modified time is in the finest units the platform keeps, so that edits
+// within the same second still show.
+typedef struct FileStamp
+{
+    uint64_t bytes;
+    int64_t modified_time;
+} FileStamp;
+
+// A read-only view of a whole file. The handles are only used on platforms
+// that need them to close the view.
+typedef struct FileMapping
+{
+    const void* contents;
+    void* file_handle;
+    void* mapping_handle;
+    uint64_t bytes;
+} FileMapping;
+
+// Writes a file a piece at a time, so it never has to be held in memory all at
+// once. Once a write fails the rest are skipped, and closing reports whether
+// everything made it.
+typedef struct FileWriter
+{
+    void* handle;
+    bool failed;
+} FileWriter;
+
+bool load_whole_file(const char* path, char** contents, uint64_t* bytes, Allocator* allocator);
 bool save_whole_file(const char* path, const void* contents, uint64_t bytes);
 
+bool file_writer_open(FileWriter* writer, const char* path);
+void file_writer_write(FileWriter* writer, const void* contents, uint64_t bytes);
+bool file_writer_close(FileWriter* writer);
+
+bool get_file_stamp(const char* path, FileStamp* stamp);
+bool map_file(FileMapping* mapping, const char* path);
+void unmap_file(FileMapping* mapping);
+
 #endif // FILESYSTEM_H_
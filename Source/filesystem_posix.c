@@ -0,0 +1,73 @@
+#include "filesystem.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool get_file_stamp(const char* path, FileStamp* stamp)
+{
+    struct stat status;
+    if(stat(path, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return false;
+    }
+
+#if defined(__APPLE__)
+    int64_t nanoseconds = (int64_t) status.st_mtimespec.tv_nsec;
+#else
+    int64_t nanoseconds = (int64_t) status.st_mtim.tv_nsec;
+#endif
+
+    stamp->bytes = (uint64_t) status.st_size;
+    stamp->modified_time = ((int64_t) status.st_mtime * 1000000000) + nanoseconds;
+
+    return true;
+}
+
+bool map_file(FileMapping* mapping, const char* path)
+{
+    mapping->contents = NULL;
+    mapping->file_handle = NULL;
+    mapping->mapping_handle = NULL;
+    mapping->bytes = 0;
+
+    int file = open(path, O_RDONLY);
+    if(file == -1)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if(fstat(file, &status) != 0 || status.st_size <= 0)
+    {
+        close(file);
+        return false;
+    }
+
+    void* contents = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    // The mapping stays valid after the descriptor is closed.
+    close(file);
+
+    if(contents == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mapping->contents = contents;
+    mapping->bytes = (uint64_t) status.st_size;
+
+    return true;
+}
+
+void unmap_file(FileMapping* mapping)
+{
+    if(mapping->contents)
+    {
+        munmap((void*) mapping->contents, (size_t) mapping->bytes);
+        mapping->contents = NULL;
+        mapping->bytes = 0;
+    }
+}
@@ -0,0 +1,80 @@
+#include "filesystem.h"
+
+#include <stddef.h>
+
+#if !defined(_WIN32_LEAN_AND_MEAN)
+#define _WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+
+bool get_file_stamp(const char* path, FileStamp* stamp)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if(!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)
+            || (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        return false;
+    }
+
+    stamp->bytes = ((uint64_t) attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    stamp->modified_time = (int64_t) (((uint64_t) attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+
+    return true;
+}
+
+bool map_file(FileMapping* mapping, const char* path)
+{
+    mapping->contents = NULL;
+    mapping->file_handle = NULL;
+    mapping->mapping_handle = NULL;
+    mapping->bytes = 0;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping_object = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!mapping_object)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* contents = MapViewOfFile(mapping_object, FILE_MAP_READ, 0, 0, 0);
+    if(!contents)
+    {
+        CloseHandle(mapping_object);
+        CloseHandle(file);
+        return false;
+    }
+
+    mapping->contents = contents;
+    mapping->file_handle = file;
+    mapping->mapping_handle = mapping_object;
+    mapping->bytes = (uint64_t) size.QuadPart;
+
+    return true;
+}
+
+void unmap_file(FileMapping* mapping)
+{
+    if(mapping->contents)
+    {
+        UnmapViewOfFile(mapping->contents);
+        CloseHandle(mapping->mapping_handle);
+        CloseHandle(mapping->file_handle);
+        mapping->contents = NULL;
+        mapping->file_handle = NULL;
+        mapping->mapping_handle = NULL;
+        mapping->bytes = 0;
+    }
+}
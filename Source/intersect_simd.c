@@ -0,0 +1,886 @@
+#include "intersect_simd.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ARCH_X86
+#endif
+
+#if defined(__GNUC__)
+#define COMPILER_GCC
+#elif defined(_MSC_VER)
+#define COMPILER_MSVC
+#endif
+
+#if defined(ARCH_X86)
+#include <immintrin.h>
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only allow intrinsics for instruction sets enabled for the
+// function they're used in, so the vector kernels are compiled for their
+// instruction set individually rather than raising it for the whole program.
+#if defined(COMPILER_GCC)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+#define SOA_PADDING 8
+
+static const float epsilon = 1e-6f;
+
+
+static int get_cap(int count)
+{
+    int per_line = CACHE_LINE_SIZE / sizeof(float);
+    int cap = count + SOA_PADDING;
+    return per_line * ((cap + per_line - 1) / per_line);
+}
+
+static bool allocate_floats(float** array, int cap, Allocator* allocator)
+{
+    *array = allocate_aligned(allocator, sizeof(float) * cap, CACHE_LINE_SIZE);
+    return *array;
+}
+
+static void deallocate_floats(float** array, int cap, Allocator* allocator)
+{
+    if(*array)
+    {
+        deallocate_aligned(allocator, *array, sizeof(float) * cap, CACHE_LINE_SIZE);
+        *array = NULL;
+    }
+}
+
+static bool allocate_indices(int** array, int cap, Allocator* allocator)
+{
+    *array = allocate_aligned(allocator, sizeof(int) * cap, CACHE_LINE_SIZE);
+    return *array;
+}
+
+static void deallocate_indices(int** array, int cap, Allocator* allocator)
+{
+    if(*array)
+    {
+        deallocate_aligned(allocator, *array, sizeof(int) * cap, CACHE_LINE_SIZE);
+        *array = NULL;
+    }
+}
+
+bool triangle_soa_create(TriangleSoa* triangles, int count, TriangleLayout layout, Allocator* allocator)
+{
+    zero_memory(triangles, sizeof(TriangleSoa));
+    triangles->allocator = allocator;
+    triangles->layout = layout;
+    triangles->count = count;
+    triangles->cap = get_cap(count);
+
+    bool allocated = true;
+    for(int axis = 0; axis < 3; axis += 1)
+    {
+        allocated = allocate_floats(&triangles->v0[axis], triangles->cap, allocator) && allocated;
+        allocated = allocate_floats(&triangles->normal[axis], triangles->cap, allocator) && allocated;
+    }
+
+    switch(layout)
+    {
+        case TRIANGLE_LAYOUT_EDGES:
+        {
+            for(int axis = 0; axis < 3; axis += 1)
+            {
+                allocated = allocate_floats(&triangles->e1[axis], triangles->cap, allocator) && allocated;
+                allocated = allocate_floats(&triangles->e2[axis], triangles->cap, allocator) && allocated;
+            }
+            break;
+        }
+        case TRIANGLE_LAYOUT_WOOP:
+        {
+            for(int element = 0; element < 12; element += 1)
+            {
+                allocated = allocate_floats(&triangles->woop[element], triangles->cap, allocator) && allocated;
+            }
+            break;
+        }
+    }
+
+    allocated = allocate_indices(&triangles->primitive_indices, triangles->cap, allocator) && allocated;
+
+    if(!allocated)
+    {
+        triangle_soa_destroy(triangles);
+        return false;
+    }
+
+    return true;
+}
+
+void triangle_soa_destroy(TriangleSoa* triangles)
+{
+    for(int axis = 0; axis < 3; axis += 1)
+    {
+        deallocate_floats(&triangles->v0[axis], triangles->cap, triangles->allocator);
+        deallocate_floats(&triangles->e1[axis], triangles->cap, triangles->allocator);
+        deallocate_floats(&triangles->e2[axis], triangles->cap, triangles->allocator);
+        deallocate_floats(&triangles->normal[axis], triangles->cap, triangles->allocator);
+    }
+    for(int element = 0; element < 12; element += 1)
+    {
+        deallocate_floats(&triangles->woop[element], triangles->cap, triangles->allocator);
+    }
+    deallocate_indices(&triangles->primitive_indices, triangles->cap, triangles->allocator);
+}
+
+void triangle_soa_set(TriangleSoa* triangles, int index, const Float3 vertices[3], int primitive_index)
+{
+    Float3 v0 = vertices[0];
+    Float3 e1 = float3_subtract(vertices[1], v0);
+    Float3 e2 = float3_subtract(vertices[2], v0);
+    Float3 n = float3_cross(e1, e2);
+
+    float area = float3_length(n);
+    Float3 normal = area > 0.0f ? float3_divide(n, area) : float3_zero;
+
+    for(int axis = 0; axis < 3; axis += 1)
+    {
+        triangles->v0[axis][index] = v0.e[axis];
+        triangles->normal[axis][index] = normal.e[axis];
+    }
+
+    switch(triangles->layout)
+    {
+        case TRIANGLE_LAYOUT_EDGES:
+        {
+            for(int axis = 0; axis < 3; axis += 1)
+            {
+                triangles->e1[axis][index] = e1.e[axis];
+                triangles->e2[axis][index] = e2.e[axis];
+            }
+            break;
+        }
+        case TRIANGLE_LAYOUT_WOOP:
+        {
+            // Invert the matrix whose columns are e1, e2, n and v0. Its inverse
+            // maps the triangle to (0, 0, 0), (1, 0, 0), (0, 1, 0). A degenerate
+            // triangle gets an all-zero transform, which no ray can hit.
+            Float3 rows[3];
+            rows[0] = float3_cross(e2, n);
+            rows[1] = float3_cross(n, e1);
+            rows[2] = n;
+
+            float determinant = float3_dot(e1, rows[0]);
+
+            for(int row = 0; row < 3; row += 1)
+            {
+                Float3 r = float3_zero;
+                float w = 0.0f;
+                if(determinant != 0.0f)
+                {
+                    r = float3_divide(rows[row], determinant);
+                    w = -float3_dot(r, v0);
+                }
+                triangles->woop[(4 * row) + 0][index] = r.x;
+                triangles->woop[(4 * row) + 1][index] = r.y;
+                triangles->woop[(4 * row) + 2][index] = r.z;
+                triangles->woop[(4 * row) + 3][index] = w;
+            }
+            break;
+        }
+    }
+
+    triangles->primitive_indices[index] = primitive_index;
+}
+
+bool sphere_soa_create(SphereSoa* spheres, int count, Allocator* allocator)
+{
+    zero_memory(spheres, sizeof(SphereSoa));
+    spheres->allocator = allocator;
+    spheres->count = count;
+    spheres->cap = get_cap(count);
+
+    bool allocated = true;
+    for(int axis = 0; axis < 3; axis += 1)
+    {
+        allocated = allocate_floats(&spheres->center[axis], spheres->cap, allocator) && allocated;
+    }
+    allocated = allocate_floats(&spheres->radius, spheres->cap, allocator) && allocated;
+    allocated = allocate_indices(&spheres->primitive_indices, spheres->cap, allocator) && allocated;
+
+    if(!allocated)
+    {
+        sphere_soa_destroy(spheres);
+        return false;
+    }
+
+    return true;
+}
+
+void sphere_soa_destroy(SphereSoa* spheres)
+{
+    for(int axis = 0; axis < 3; axis += 1)
+    {
+        deallocate_floats(&spheres->center[axis], spheres->cap, spheres->allocator);
+    }
+    deallocate_floats(&spheres->radius, spheres->cap, spheres->allocator);
+    deallocate_indices(&spheres->primitive_indices, spheres->cap, spheres->allocator);
+}
+
+
+// Scalar Kernels...............................................................
+
+static int intersect_triangles_scalar(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    int result = -1;
+
+    for(int index = first; index < first + count; index += 1)
+    {
+        Float3 v0 = {triangles->v0[0][index], triangles->v0[1][index], triangles->v0[2][index]};
+        Float3 e1 = {triangles->e1[0][index], triangles->e1[1][index], triangles->e1[2][index]};
+        Float3 e2 = {triangles->e2[0][index], triangles->e2[1][index], triangles->e2[2][index]};
+
+        Float3 p = float3_cross(direction, e2);
+        float determinant = float3_dot(e1, p);
+        if(fabsf(determinant) < epsilon)
+        {
+            continue;
+        }
+
+        float inv_det = 1.0f / determinant;
+
+        Float3 s = float3_subtract(origin, v0);
+        float u = inv_det * float3_dot(s, p);
+        if(u < 0.0f || u > 1.0f)
+        {
+            continue;
+        }
+
+        Float3 q = float3_cross(s, e1);
+        float v = inv_det * float3_dot(direction, q);
+        if(v < 0.0f || u + v > 1.0f)
+        {
+            continue;
+        }
+
+        float t = inv_det * float3_dot(e2, q);
+        if(t > t_min && t < *t_max)
+        {
+            *t_max = t;
+            result = index;
+        }
+    }
+
+    return result;
+}
+
+// Woop's unit triangle test. The ray is carried into the triangle's own space,
+// where finding where it crosses the plane z = 0 gives both the distance and
+// the barycentric coordinates directly.
+static int intersect_woop_triangles_scalar(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    int result = -1;
+
+    for(int index = first; index < first + count; index += 1)
+    {
+        float* const* m = triangles->woop;
+
+        float oz = (m[8][index] * origin.x) + (m[9][index] * origin.y) + (m[10][index] * origin.z) + m[11][index];
+        float dz = (m[8][index] * direction.x) + (m[9][index] * direction.y) + (m[10][index] * direction.z);
+        float t = -oz / dz;
+        if(!(t > t_min && t < *t_max))
+        {
+            continue;
+        }
+
+        float ox = (m[0][index] * origin.x) + (m[1][index] * origin.y) + (m[2][index] * origin.z) + m[3][index];
+        float dx = (m[0][index] * direction.x) + (m[1][index] * direction.y) + (m[2][index] * direction.z);
+        float u = ox + (t * dx);
+        if(u < 0.0f || u > 1.0f)
+        {
+            continue;
+        }
+
+        float oy = (m[4][index] * origin.x) + (m[5][index] * origin.y) + (m[6][index] * origin.z) + m[7][index];
+        float dy = (m[4][index] * direction.x) + (m[5][index] * direction.y) + (m[6][index] * direction.z);
+        float v = oy + (t * dy);
+        if(v < 0.0f || u + v > 1.0f)
+        {
+            continue;
+        }
+
+        *t_max = t;
+        result = index;
+    }
+
+    return result;
+}
+
+static int intersect_spheres_scalar(const SphereSoa* spheres, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    int result = -1;
+
+    for(int index = first; index < first + count; index += 1)
+    {
+        Float3 center = {spheres->center[0][index], spheres->center[1][index], spheres->center[2][index]};
+        float radius = spheres->radius[index];
+
+        Float3 l = float3_subtract(center, origin);
+        float tca = float3_dot(l, direction);
+        if(tca < 0.0f)
+        {
+            continue;
+        }
+
+        float d2 = float3_squared_length(l) - (tca * tca);
+        float radius2 = radius * radius;
+        if(d2 > radius2)
+        {
+            continue;
+        }
+
+        float thc = sqrtf(radius2 - d2);
+        float t = tca - thc;
+        if(t < 0.0f)
+        {
+            t = tca + thc;
+        }
+
+        if(t >= 0.0f && t > t_min && t < *t_max)
+        {
+            *t_max = t;
+            result = index;
+        }
+    }
+
+    return result;
+}
+
+
+#if defined(ARCH_X86)
+
+// SSE2 Kernels.................................................................
+
+TARGET_SSE2
+static int closest_lane_sse2(__m128 valid, __m128 t, int base, float* closest)
+{
+    int mask = _mm_movemask_ps(valid);
+    if(!mask)
+    {
+        return -1;
+    }
+
+    float distances[4];
+    _mm_storeu_ps(distances, t);
+
+    int result = -1;
+    for(int lane = 0; lane < 4; lane += 1)
+    {
+        if((mask & (1 << lane)) && distances[lane] < *closest)
+        {
+            *closest = distances[lane];
+            result = base + lane;
+        }
+    }
+
+    return result;
+}
+
+TARGET_SSE2
+static int intersect_triangles_sse2(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    __m128 ox = _mm_set1_ps(origin.x);
+    __m128 oy = _mm_set1_ps(origin.y);
+    __m128 oz = _mm_set1_ps(origin.z);
+    __m128 dx = _mm_set1_ps(direction.x);
+    __m128 dy = _mm_set1_ps(direction.y);
+    __m128 dz = _mm_set1_ps(direction.z);
+    __m128 minimum = _mm_set1_ps(t_min);
+
+    int result = -1;
+    float closest = *t_max;
+
+    for(int base = first; base < first + count; base += 4)
+    {
+        __m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps((float) (first + count - base)));
+
+        __m128 v0x = _mm_loadu_ps(&triangles->v0[0][base]);
+        __m128 v0y = _mm_loadu_ps(&triangles->v0[1][base]);
+        __m128 v0z = _mm_loadu_ps(&triangles->v0[2][base]);
+
+        __m128 e1x = _mm_loadu_ps(&triangles->e1[0][base]);
+        __m128 e1y = _mm_loadu_ps(&triangles->e1[1][base]);
+        __m128 e1z = _mm_loadu_ps(&triangles->e1[2][base]);
+        __m128 e2x = _mm_loadu_ps(&triangles->e2[0][base]);
+        __m128 e2y = _mm_loadu_ps(&triangles->e2[1][base]);
+        __m128 e2z = _mm_loadu_ps(&triangles->e2[2][base]);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+        __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(_mm_andnot_ps(sign_mask, determinant), _mm_set1_ps(epsilon)));
+        __m128 inv_det = _mm_div_ps(one, determinant);
+
+        __m128 sx = _mm_sub_ps(ox, v0x);
+        __m128 sy = _mm_sub_ps(oy, v0y);
+        __m128 sz = _mm_sub_ps(oz, v0z);
+
+        __m128 u = _mm_mul_ps(inv_det, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+        __m128 v = _mm_mul_ps(inv_det, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+        __m128 t = _mm_mul_ps(inv_det, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, minimum), _mm_cmplt_ps(t, _mm_set1_ps(closest))));
+
+        int lane_hit = closest_lane_sse2(valid, t, base, &closest);
+        if(lane_hit != -1)
+        {
+            result = lane_hit;
+        }
+    }
+
+    *t_max = closest;
+
+    return result;
+}
+
+TARGET_SSE2
+static int intersect_woop_triangles_sse2(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    __m128 ox = _mm_set1_ps(origin.x);
+    __m128 oy = _mm_set1_ps(origin.y);
+    __m128 oz = _mm_set1_ps(origin.z);
+    __m128 dx = _mm_set1_ps(direction.x);
+    __m128 dy = _mm_set1_ps(direction.y);
+    __m128 dz = _mm_set1_ps(direction.z);
+    __m128 minimum = _mm_set1_ps(t_min);
+
+    int result = -1;
+    float closest = *t_max;
+
+    for(int base = first; base < first + count; base += 4)
+    {
+        __m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps((float) (first + count - base)));
+
+        __m128 m00 = _mm_loadu_ps(&triangles->woop[0][base]);
+        __m128 m01 = _mm_loadu_ps(&triangles->woop[1][base]);
+        __m128 m02 = _mm_loadu_ps(&triangles->woop[2][base]);
+        __m128 m03 = _mm_loadu_ps(&triangles->woop[3][base]);
+        __m128 m10 = _mm_loadu_ps(&triangles->woop[4][base]);
+        __m128 m11 = _mm_loadu_ps(&triangles->woop[5][base]);
+        __m128 m12 = _mm_loadu_ps(&triangles->woop[6][base]);
+        __m128 m13 = _mm_loadu_ps(&triangles->woop[7][base]);
+        __m128 m20 = _mm_loadu_ps(&triangles->woop[8][base]);
+        __m128 m21 = _mm_loadu_ps(&triangles->woop[9][base]);
+        __m128 m22 = _mm_loadu_ps(&triangles->woop[10][base]);
+        __m128 m23 = _mm_loadu_ps(&triangles->woop[11][base]);
+
+        __m128 local_oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, ox), _mm_mul_ps(m21, oy)), _mm_mul_ps(m22, oz)), m23);
+        __m128 local_dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, dx), _mm_mul_ps(m21, dy)), _mm_mul_ps(m22, dz));
+        __m128 t = _mm_div_ps(_mm_sub_ps(zero, local_oz), local_dz);
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, minimum), _mm_cmplt_ps(t, _mm_set1_ps(closest))));
+
+        __m128 local_ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, ox), _mm_mul_ps(m01, oy)), _mm_mul_ps(m02, oz)), m03);
+        __m128 local_dx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, dx), _mm_mul_ps(m01, dy)), _mm_mul_ps(m02, dz));
+        __m128 u = _mm_add_ps(local_ox, _mm_mul_ps(t, local_dx));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+        __m128 local_oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, ox), _mm_mul_ps(m11, oy)), _mm_mul_ps(m12, oz)), m13);
+        __m128 local_dy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, dx), _mm_mul_ps(m11, dy)), _mm_mul_ps(m12, dz));
+        __m128 v = _mm_add_ps(local_oy, _mm_mul_ps(t, local_dy));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+        int lane_hit = closest_lane_sse2(valid, t, base, &closest);
+        if(lane_hit != -1)
+        {
+            result = lane_hit;
+        }
+    }
+
+    *t_max = closest;
+
+    return result;
+}
+
+TARGET_SSE2
+static int intersect_spheres_sse2(const SphereSoa* spheres, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    __m128 ox = _mm_set1_ps(origin.x);
+    __m128 oy = _mm_set1_ps(origin.y);
+    __m128 oz = _mm_set1_ps(origin.z);
+    __m128 dx = _mm_set1_ps(direction.x);
+    __m128 dy = _mm_set1_ps(direction.y);
+    __m128 dz = _mm_set1_ps(direction.z);
+    __m128 minimum = _mm_set1_ps(t_min);
+
+    int result = -1;
+    float closest = *t_max;
+
+    for(int base = first; base < first + count; base += 4)
+    {
+        __m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps((float) (first + count - base)));
+
+        __m128 lx = _mm_sub_ps(_mm_loadu_ps(&spheres->center[0][base]), ox);
+        __m128 ly = _mm_sub_ps(_mm_loadu_ps(&spheres->center[1][base]), oy);
+        __m128 lz = _mm_sub_ps(_mm_loadu_ps(&spheres->center[2][base]), oz);
+        __m128 radius = _mm_loadu_ps(&spheres->radius[base]);
+
+        __m128 tca = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, dx), _mm_mul_ps(ly, dy)), _mm_mul_ps(lz, dz));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(tca, zero));
+
+        __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz));
+        __m128 d2 = _mm_sub_ps(l2, _mm_mul_ps(tca, tca));
+        __m128 radius2 = _mm_mul_ps(radius, radius);
+        valid = _mm_and_ps(valid, _mm_cmple_ps(d2, radius2));
+
+        __m128 thc = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(radius2, d2), zero));
+        __m128 t0 = _mm_sub_ps(tca, thc);
+        __m128 t1 = _mm_add_ps(tca, thc);
+        __m128 behind = _mm_cmplt_ps(t0, zero);
+        __m128 t = _mm_or_ps(_mm_and_ps(behind, t1), _mm_andnot_ps(behind, t0));
+
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, minimum), _mm_cmplt_ps(t, _mm_set1_ps(closest))));
+
+        int lane_hit = closest_lane_sse2(valid, t, base, &closest);
+        if(lane_hit != -1)
+        {
+            result = lane_hit;
+        }
+    }
+
+    *t_max = closest;
+
+    return result;
+}
+
+
+// AVX2 Kernels.................................................................
+
+TARGET_AVX2
+static int closest_lane_avx2(__m256 valid, __m256 t, int base, float* closest)
+{
+    int mask = _mm256_movemask_ps(valid);
+    if(!mask)
+    {
+        return -1;
+    }
+
+    float distances[8];
+    _mm256_storeu_ps(distances, t);
+
+    int result = -1;
+    for(int lane = 0; lane < 8; lane += 1)
+    {
+        if((mask & (1 << lane)) && distances[lane] < *closest)
+        {
+            *closest = distances[lane];
+            result = base + lane;
+        }
+    }
+
+    return result;
+}
+
+TARGET_AVX2
+static int intersect_triangles_avx2(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    __m256 ox = _mm256_set1_ps(origin.x);
+    __m256 oy = _mm256_set1_ps(origin.y);
+    __m256 oz = _mm256_set1_ps(origin.z);
+    __m256 dx = _mm256_set1_ps(direction.x);
+    __m256 dy = _mm256_set1_ps(direction.y);
+    __m256 dz = _mm256_set1_ps(direction.z);
+    __m256 minimum = _mm256_set1_ps(t_min);
+
+    int result = -1;
+    float closest = *t_max;
+
+    for(int base = first; base < first + count; base += 8)
+    {
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps((float) (first + count - base)), _CMP_LT_OQ);
+
+        __m256 v0x = _mm256_loadu_ps(&triangles->v0[0][base]);
+        __m256 v0y = _mm256_loadu_ps(&triangles->v0[1][base]);
+        __m256 v0z = _mm256_loadu_ps(&triangles->v0[2][base]);
+
+        __m256 e1x = _mm256_loadu_ps(&triangles->e1[0][base]);
+        __m256 e1y = _mm256_loadu_ps(&triangles->e1[1][base]);
+        __m256 e1z = _mm256_loadu_ps(&triangles->e1[2][base]);
+        __m256 e2x = _mm256_loadu_ps(&triangles->e2[0][base]);
+        __m256 e2y = _mm256_loadu_ps(&triangles->e2[1][base]);
+        __m256 e2z = _mm256_loadu_ps(&triangles->e2[2][base]);
+
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+
+        __m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, determinant), _mm256_set1_ps(epsilon), _CMP_GE_OQ));
+        __m256 inv_det = _mm256_div_ps(one, determinant);
+
+        __m256 sx = _mm256_sub_ps(ox, v0x);
+        __m256 sy = _mm256_sub_ps(oy, v0y);
+        __m256 sz = _mm256_sub_ps(oz, v0z);
+
+        __m256 u = _mm256_mul_ps(inv_det, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+
+        __m256 v = _mm256_mul_ps(inv_det, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+        __m256 t = _mm256_mul_ps(inv_det, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, minimum, _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(closest), _CMP_LT_OQ)));
+
+        int lane_hit = closest_lane_avx2(valid, t, base, &closest);
+        if(lane_hit != -1)
+        {
+            result = lane_hit;
+        }
+    }
+
+    *t_max = closest;
+
+    return result;
+}
+
+TARGET_AVX2
+static int intersect_woop_triangles_avx2(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+    __m256 ox = _mm256_set1_ps(origin.x);
+    __m256 oy = _mm256_set1_ps(origin.y);
+    __m256 oz = _mm256_set1_ps(origin.z);
+    __m256 dx = _mm256_set1_ps(direction.x);
+    __m256 dy = _mm256_set1_ps(direction.y);
+    __m256 dz = _mm256_set1_ps(direction.z);
+    __m256 minimum = _mm256_set1_ps(t_min);
+
+    int result = -1;
+    float closest = *t_max;
+
+    for(int base = first; base < first + count; base += 8)
+    {
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps((float) (first + count - base)), _CMP_LT_OQ);
+
+        __m256 m00 = _mm256_loadu_ps(&triangles->woop[0][base]);
+        __m256 m01 = _mm256_loadu_ps(&triangles->woop[1][base]);
+        __m256 m02 = _mm256_loadu_ps(&triangles->woop[2][base]);
+        __m256 m03 = _mm256_loadu_ps(&triangles->woop[3][base]);
+        __m256 m10 = _mm256_loadu_ps(&triangles->woop[4][base]);
+        __m256 m11 = _mm256_loadu_ps(&triangles->woop[5][base]);
+        __m256 m12 = _mm256_loadu_ps(&triangles->woop[6][base]);
+        __m256 m13 = _mm256_loadu_ps(&triangles->woop[7][base]);
+        __m256 m20 = _mm256_loadu_ps(&triangles->woop[8][base]);
+        __m256 m21 = _mm256_loadu_ps(&triangles->woop[9][base]);
+        __m256 m22 = _mm256_loadu_ps(&triangles->woop[10][base]);
+        __m256 m23 = _mm256_loadu_ps(&triangles->woop[11][base]);
+
+        __m256 local_oz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, ox), _mm256_mul_ps(m21, oy)), _mm256_mul_ps(m22, oz)), m23);
+        __m256 local_dz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, dx), _mm256_mul_ps(m21, dy)), _mm256_mul_ps(m22, dz));
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(zero, local_oz), local_dz);
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, minimum, _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(closest), _CMP_LT_OQ)));
+
+        __m256 local_ox = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, ox), _mm256_mul_ps(m01, oy)), _mm256_mul_ps(m02, oz)), m03);
+        __m256 local_dx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, dx), _mm256_mul_ps(m01, dy)), _mm256_mul_ps(m02, dz));
+        __m256 u = _mm256_add_ps(local_ox, _mm256_mul_ps(t, local_dx));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+        __m256 local_oy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, ox), _mm256_mul_ps(m11, oy)), _mm256_mul_ps(m12, oz)), m13);
+        __m256 local_dy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, dx), _mm256_mul_ps(m11, dy)), _mm256_mul_ps(m12, dz));
+        __m256 v = _mm256_add_ps(local_oy, _mm256_mul_ps(t, local_dy));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+        int lane_hit = closest_lane_avx2(valid, t, base, &closest);
+        if(lane_hit != -1)
+        {
+            result = lane_hit;
+        }
+    }
+
+    *t_max = closest;
+
+    return result;
+}
+
+TARGET_AVX2
+static int intersect_spheres_avx2(const SphereSoa* spheres, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+    __m256 ox = _mm256_set1_ps(origin.x);
+    __m256 oy = _mm256_set1_ps(origin.y);
+    __m256 oz = _mm256_set1_ps(origin.z);
+    __m256 dx = _mm256_set1_ps(direction.x);
+    __m256 dy = _mm256_set1_ps(direction.y);
+    __m256 dz = _mm256_set1_ps(direction.z);
+    __m256 minimum = _mm256_set1_ps(t_min);
+
+    int result = -1;
+    float closest = *t_max;
+
+    for(int base = first; base < first + count; base += 8)
+    {
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps((float) (first + count - base)), _CMP_LT_OQ);
+
+        __m256 lx = _mm256_sub_ps(_mm256_loadu_ps(&spheres->center[0][base]), ox);
+        __m256 ly = _mm256_sub_ps(_mm256_loadu_ps(&spheres->center[1][base]), oy);
+        __m256 lz = _mm256_sub_ps(_mm256_loadu_ps(&spheres->center[2][base]), oz);
+        __m256 radius = _mm256_loadu_ps(&spheres->radius[base]);
+
+        __m256 tca = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, dx), _mm256_mul_ps(ly, dy)), _mm256_mul_ps(lz, dz));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(tca, zero, _CMP_GE_OQ));
+
+        __m256 l2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz));
+        __m256 d2 = _mm256_sub_ps(l2, _mm256_mul_ps(tca, tca));
+        __m256 radius2 = _mm256_mul_ps(radius, radius);
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(d2, radius2, _CMP_LE_OQ));
+
+        __m256 thc = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(radius2, d2), zero));
+        __m256 t0 = _mm256_sub_ps(tca, thc);
+        __m256 t1 = _mm256_add_ps(tca, thc);
+        __m256 t = _mm256_blendv_ps(t0, t1, _mm256_cmp_ps(t0, zero, _CMP_LT_OQ));
+
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, minimum, _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(closest), _CMP_LT_OQ)));
+
+        int lane_hit = closest_lane_avx2(valid, t, base, &closest);
+        if(lane_hit != -1)
+        {
+            result = lane_hit;
+        }
+    }
+
+    *t_max = closest;
+
+    return result;
+}
+
+#endif // defined(ARCH_X86)
+
+
+SimdLevel detect_simd_level(void)
+{
+#if defined(ARCH_X86) && defined(COMPILER_GCC)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_LEVEL_AVX2;
+    }
+    if(__builtin_cpu_supports("sse2"))
+    {
+        return SIMD_LEVEL_SSE2;
+    }
+#elif defined(ARCH_X86) && defined(COMPILER_MSVC)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = info[3] & (1 << 26);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+
+    // The operating system also has to save the upper halves of the vector
+    // registers on context switches for AVX to be usable.
+    if(max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        if(info[1] & (1 << 5))
+        {
+            return SIMD_LEVEL_AVX2;
+        }
+    }
+    if(sse2)
+    {
+        return SIMD_LEVEL_SSE2;
+    }
+#endif
+
+    return SIMD_LEVEL_SCALAR;
+}
+
+IntersectKernels get_intersect_kernels(SimdLevel level, TriangleLayout layout)
+{
+    bool woop = layout == TRIANGLE_LAYOUT_WOOP;
+
+    IntersectKernels kernels;
+    kernels.intersect_triangles = woop ? intersect_woop_triangles_scalar : intersect_triangles_scalar;
+    kernels.intersect_spheres = intersect_spheres_scalar;
+    kernels.level = SIMD_LEVEL_SCALAR;
+
+#if defined(ARCH_X86)
+    switch(level)
+    {
+        case SIMD_LEVEL_AVX2:
+        {
+            kernels.intersect_triangles = woop ? intersect_woop_triangles_avx2 : intersect_triangles_avx2;
+            kernels.intersect_spheres = intersect_spheres_avx2;
+            kernels.level = SIMD_LEVEL_AVX2;
+            break;
+        }
+        case SIMD_LEVEL_SSE2:
+        {
+            kernels.intersect_triangles = woop ? intersect_woop_triangles_sse2 : intersect_triangles_sse2;
+            kernels.intersect_spheres = intersect_spheres_sse2;
+            kernels.level = SIMD_LEVEL_SSE2;
+            break;
+        }
+        case SIMD_LEVEL_SCALAR:
+        {
+            break;
+        }
+    }
+#else
+    (void) level;
+#endif
+
+    return kernels;
+}
+
+const char* simd_level_name(SimdLevel level)
+{
+    switch(level)
+    {
+        case SIMD_LEVEL_AVX2:   return "AVX2";
+        case SIMD_LEVEL_SSE2:   return "SSE2";
+        case SIMD_LEVEL_SCALAR: return "scalar";
+    }
+    return "unknown";
+}
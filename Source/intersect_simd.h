@@ -0,0 +1,91 @@
+// Vectorised Intersection Kernels
+//
+// These test one ray against a run of primitives stored in
+// structure-of-arrays layout, four or eight at a time depending on what the
+// processor supports. The kernel used is picked at runtime.
+
+#ifndef INTERSECT_SIMD_H_
+#define INTERSECT_SIMD_H_
+
+#include "memory.h"
+#include "vector_math.h"
+
+#include <stdbool.h>
+
+// How triangles are stored for intersection. Both forms are worked out once
+// when the arrays are filled, so the kernels only do the arithmetic that
+// depends on the ray.
+//
+// The edges form holds the first vertex and the two edges leaving it, for the
+// Moller-Trumbore test. The Woop form holds the affine transform taking world
+// space to a space where the triangle is the unit triangle, for Woop's test.
+typedef enum TriangleLayout
+{
+    TRIANGLE_LAYOUT_EDGES,
+    TRIANGLE_LAYOUT_WOOP,
+} TriangleLayout;
+
+// Arrays have at least eight elements of zeroed padding past the end, so a
+// kernel can load a full vector from any valid index. Lanes past the run being
+// tested are masked off. Each array starts on a cache line and is a whole
+// number of cache lines long, so a run of primitives streams through as few
+// lines as it can, and no two arrays share a line.
+//
+// The vertex v0 and unit normal are kept for either layout, since they're
+// needed to orient the normal at a hit. The edge arrays are only allocated for
+// the edges layout and the transform rows only for the Woop layout.
+typedef struct TriangleSoa
+{
+    Allocator* allocator;
+    float* v0[3];
+    float* e1[3];
+    float* e2[3];
+    float* normal[3];
+    float* woop[12];
+    int* primitive_indices;
+    TriangleLayout layout;
+    int cap;
+    int count;
+} TriangleSoa;
+
+typedef struct SphereSoa
+{
+    Allocator* allocator;
+    float* center[3];
+    float* radius;
+    int* primitive_indices;
+    int cap;
+    int count;
+} SphereSoa;
+
+// Each kernel tests the ray against elements [first, first + count) and
+// returns the index of the closest one hit between t_min and *t_max, or -1 if
+// none were. When there's a hit *t_max is updated to its distance.
+typedef int (*IntersectTrianglesCall)(const TriangleSoa* triangles, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max);
+typedef int (*IntersectSpheresCall)(const SphereSoa* spheres, Float3 origin, Float3 direction, int first, int count, float t_min, float* t_max);
+
+typedef enum SimdLevel
+{
+    SIMD_LEVEL_SCALAR,
+    SIMD_LEVEL_SSE2,
+    SIMD_LEVEL_AVX2,
+} SimdLevel;
+
+typedef struct IntersectKernels
+{
+    IntersectTrianglesCall intersect_triangles;
+    IntersectSpheresCall intersect_spheres;
+    SimdLevel level;
+} IntersectKernels;
+
+bool triangle_soa_create(TriangleSoa* triangles, int count, TriangleLayout layout, Allocator* allocator);
+void triangle_soa_destroy(TriangleSoa* triangles);
+void triangle_soa_set(TriangleSoa* triangles, int index, const Float3 vertices[3], int primitive_index);
+bool sphere_soa_create(SphereSoa* spheres, int count, Allocator* allocator);
+void sphere_soa_destroy(SphereSoa* spheres);
+
+SimdLevel detect_simd_level(void);
+IntersectKernels get_intersect_kernels(SimdLevel level, TriangleLayout layout);
+const char* simd_level_name(SimdLevel level);
+
+#endif // INTERSECT_SIMD_H_
@@ -0,0 +1,214 @@
+#include "light.h"
+
+#define _USE_MATH_DEFINES
+#include <float.h>
+#include <math.h>
+
+// One minus the cosine of the half-angle of the cone a sphere subtends, or
+// zero if the point is inside it. It's worked out from the squared sine so it
+// stays accurate for small, distant spheres.
+static float sphere_cone_extent(Sphere sphere, Float3 point)
+{
+    float squared_distance = float3_squared_length(float3_subtract(sphere.center, point));
+    float squared_radius = sphere.radius * sphere.radius;
+    if(squared_distance <= squared_radius)
+    {
+        return 0.0f;
+    }
+
+    float squared_sin_max = squared_radius / squared_distance;
+    float cos_max = sqrtf(1.0f - squared_sin_max);
+    return squared_sin_max / (1.0f + cos_max);
+}
+
+static LightSample sample_sphere_light(const World* world, Light light, Float3 point, Float2 u)
+{
+    LightSample result;
+    result.valid = false;
+
+    Sphere sphere = world->spheres[light.index];
+    float extent = sphere_cone_extent(sphere, point);
+    if(extent <= 0.0f)
+    {
+        return result;
+    }
+
+    Float3 to_center = float3_subtract(sphere.center, point);
+    float center_distance = float3_length(to_center);
+    Float3 axis = float3_divide(to_center, center_distance);
+
+    float cos_theta = 1.0f - (u.x * extent);
+    float sin_theta = sqrtf(fmaxf(1.0f - (cos_theta * cos_theta), 0.0f));
+    float phi = 2.0f * (float) M_PI * u.y;
+
+    Float3 tangent;
+    Float3 bitangent;
+    float3_make_basis(axis, &tangent, &bitangent);
+
+    Float3 incoming = float3_multiply(cos_theta, axis);
+    incoming = float3_add(incoming, float3_multiply(sin_theta * cosf(phi), tangent));
+    incoming = float3_add(incoming, float3_multiply(sin_theta * sinf(phi), bitangent));
+
+    // Distance to the near side of the sphere along the sampled direction.
+    float projection = center_distance * cos_theta;
+    float squared_offset = (center_distance * center_distance) - (projection * projection);
+    float half_chord = sqrtf(fmaxf((sphere.radius * sphere.radius) - squared_offset, 0.0f));
+
+    result.incoming = incoming;
+    result.radiance = world->materials[light.material_index].emittance;
+    result.distance = projection - half_chord;
+    result.pdf = 1.0f / (2.0f * (float) M_PI * extent);
+    result.valid = true;
+
+    return result;
+}
+
+static LightSample sample_triangle_light(const World* world, Light light, Float3 point, Float2 u)
+{
+    LightSample result;
+    result.valid = false;
+
+    Triangle triangle = world->triangles[light.index];
+    Float3 edge1 = float3_subtract(triangle.vertices[1], triangle.vertices[0]);
+    Float3 edge2 = float3_subtract(triangle.vertices[2], triangle.vertices[0]);
+    Float3 cross = float3_cross(edge1, edge2);
+    float double_area = float3_length(cross);
+    if(double_area <= 0.0f)
+    {
+        return result;
+    }
+
+    float root = sqrtf(u.x);
+    float b1 = root * (1.0f - u.y);
+    float b2 = root * u.y;
+    Float3 light_point = float3_add(triangle.vertices[0], float3_add(float3_multiply(b1, edge1), float3_multiply(b2, edge2)));
+
+    Float3 to_light = float3_subtract(light_point, point);
+    float squared_distance = float3_squared_length(to_light);
+    float distance = sqrtf(squared_distance);
+    if(distance <= 0.0f)
+    {
+        return result;
+    }
+
+    Float3 incoming = float3_divide(to_light, distance);
+    float cos_light = fabsf(float3_dot(incoming, cross)) / double_area;
+    if(cos_light <= 1e-6f)
+    {
+        return result;
+    }
+
+    result.incoming = incoming;
+    result.radiance = world->materials[light.material_index].emittance;
+    result.distance = distance;
+    result.pdf = (2.0f * squared_distance) / (double_area * cos_light);
+    result.valid = true;
+
+    return result;
+}
+
+static LightSample sample_environment_light(const World* world, Float2 u)
+{
+    float z = 1.0f - (2.0f * u.x);
+    float r = sqrtf(fmaxf(1.0f - (z * z), 0.0f));
+    float phi = 2.0f * (float) M_PI * u.y;
+
+    LightSample result;
+    result.incoming.x = r * cosf(phi);
+    result.incoming.y = r * sinf(phi);
+    result.incoming.z = z;
+    result.radiance = world->materials[0].emittance;
+    result.distance = FLT_MAX;
+    result.pdf = 1.0f / (4.0f * (float) M_PI);
+    result.valid = true;
+
+    return result;
+}
+
+LightSample light_sample(const World* world, Float3 point, float select_sample, Float2 position_sample)
+{
+    LightSample result;
+    result.valid = false;
+
+    if(world->lights_count == 0)
+    {
+        return result;
+    }
+
+    int light_index = (int) (select_sample * world->lights_count);
+    if(light_index >= world->lights_count)
+    {
+        light_index = world->lights_count - 1;
+    }
+
+    Light light = world->lights[light_index];
+
+    switch(light.type)
+    {
+        case LIGHT_TYPE_ENVIRONMENT:
+        {
+            result = sample_environment_light(world, position_sample);
+            break;
+        }
+        case LIGHT_TYPE_SPHERE:
+        {
+            result = sample_sphere_light(world, light, point, position_sample);
+            break;
+        }
+        case LIGHT_TYPE_TRIANGLE:
+        {
+            result = sample_triangle_light(world, light, point, position_sample);
+            break;
+        }
+    }
+
+    result.pdf /= world->lights_count;
+
+    return result;
+}
+
+// The pdf that light_sample would have picked the given direction from the
+// point, where hit is what a ray from the point in that direction hit.
+float light_pdf(const World* world, Float3 point, Float3 incoming, Hit hit)
+{
+    if(hit.light_index < 0)
+    {
+        return 0.0f;
+    }
+
+    Light light = world->lights[hit.light_index];
+    float pdf = 0.0f;
+
+    switch(light.type)
+    {
+        case LIGHT_TYPE_ENVIRONMENT:
+        {
+            pdf = 1.0f / (4.0f * (float) M_PI);
+            break;
+        }
+        case LIGHT_TYPE_SPHERE:
+        {
+            float extent = sphere_cone_extent(world->spheres[light.index], point);
+            if(extent > 0.0f)
+            {
+                pdf = 1.0f / (2.0f * (float) M_PI * extent);
+            }
+            break;
+        }
+        case LIGHT_TYPE_TRIANGLE:
+        {
+            Triangle triangle = world->triangles[light.index];
+            Float3 edge1 = float3_subtract(triangle.vertices[1], triangle.vertices[0]);
+            Float3 edge2 = float3_subtract(triangle.vertices[2], triangle.vertices[0]);
+            float double_area = float3_length(float3_cross(edge1, edge2));
+            float cos_light = fabsf(float3_dot(incoming, hit.normal));
+            if(double_area > 0.0f && cos_light > 1e-6f)
+            {
+                pdf = (2.0f * hit.distance * hit.distance) / (double_area * cos_light);
+            }
+            break;
+        }
+    }
+
+    return pdf / world->lights_count;
+}
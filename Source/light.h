@@ -0,0 +1,29 @@
+// Light Sampling
+//
+// Picks one of the world's lights uniformly and samples a direction towards
+// it from a point. Spheres are sampled by the cone of directions they
+// subtend, triangles by area, and the environment over the whole sphere. The
+// pdfs are per unit solid angle at the point and include the chance of picking
+// the light, so they can be compared directly with BSDF pdfs.
+
+#ifndef LIGHT_H_
+#define LIGHT_H_
+
+#include "vector_math.h"
+#include "world.h"
+
+#include <stdbool.h>
+
+typedef struct LightSample
+{
+    Float3 incoming;
+    Float3 radiance;
+    float distance;
+    float pdf;
+    bool valid;
+} LightSample;
+
+LightSample light_sample(const World* world, Float3 point, float select_sample, Float2 position_sample);
+float light_pdf(const World* world, Float3 point, Float3 incoming, Hit hit);
+
+#endif // LIGHT_H_
@@ -1,632 +1,660 @@
-#include "assert.h"
 #include "bmp.h"
-#include "random.h"
+#include "pfm.h"
+#include "profile.h"
+#include "render.h"
+#include "scene.h"
 #include "thread_pool.h"
 #include "vector_math.h"
+#include "world.h"
 
-#include <float.h>
-#define _USE_MATH_DEFINES
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-typedef union Pack4x8
+static void resolve_row(void* data, int y, float* row)
 {
-    struct
-    {
-        uint8_t b, g, r, a;
-    };
-    uint32_t packed;
-} Pack4x8;
-
-typedef union PixelU32
-{
-    struct
-    {
-        uint8_t r;
-        uint8_t g;
-        uint8_t b;
-        uint8_t a;
-    };
-    uint32_t value;
-} PixelU32;
-
-typedef struct Image
-{
-    PixelU32* pixels;
-    Int2 dimensions;
-} Image;
-
-typedef struct Rect
-{
-    Int2 bottom_left;
-    Int2 dimensions;
-} Rect;
-
-typedef struct Camera
-{
-    Float3 position;
-    Float3 target;
-    float field_of_view;
-} Camera;
-
-typedef struct Material
-{
-    Float3 emittance;
-    Float3 reflectance;
-    float glossiness;
-} Material;
-
-typedef struct Triangle
-{
-    Float3 vertices[3];
-} Triangle;
-
-typedef struct Mesh
-{
-    Triangle triangles[16];
-    int triangles_count;
-    uint32_t material_index;
-} Mesh;
-
-typedef struct Plane
-{
-    Float3 normal;
-    float d;
-    uint32_t material_index;
-} Plane;
-
-typedef struct Ray
-{
-    Float3 origin;
-    Float3 direction;
-} Ray;
-
-typedef struct Sphere
-{
-    Float3 center;
-    float radius;
-    uint32_t material_index;
-} Sphere;
-
-typedef struct World
-{
-    Material materials[4];
-    Mesh meshes[4];
-    Plane planes[4];
-    Sphere spheres[4];
-    int materials_count;
-    int meshes_count;
-    int planes_count;
-    int spheres_count;
-} World;
-
-typedef struct Tile
-{
-    Rect image_region;
-    Camera* camera;
-    Image* image;
-    World* world;
-} Tile;
-
-typedef struct MaybeFloat
-{
-    float value;
-    bool valid;
-} MaybeFloat;
-
-void image_destroy(Image* image)
-{
-    deallocate(NULL, image->pixels, sizeof(PixelU32) * image->dimensions.x * image->dimensions.y);
-}
-
-static uint32_t pack_unorm3x8(Float3 v)
-{
-    Pack4x8 u;
-    u.r = (uint8_t) (0xff * v.x);
-    u.g = (uint8_t) (0xff * v.y);
-    u.b = (uint8_t) (0xff * v.z);
-    u.a = 0xff;
-    return u.packed;
-}
-
-static bool is_unorm(float x)
-{
-    return x >= 0.0f && x <= 1.0f;
+    accumulation_buffer_resolve_row(data, y, row);
 }
 
-uint32_t rgb_to_uint32(Float3 c)
+// Everything about a render that can be chosen from the command line.
+typedef struct Settings
 {
-    ASSERT(is_unorm(c.x));
-    ASSERT(is_unorm(c.y));
-    ASSERT(is_unorm(c.z));
-    return pack_unorm3x8(c);
-}
-
-static float linear_to_srgb_component(float x)
+    Int2 dimensions;
+    Int2 tile_dimensions;
+    const char* output_path;
+    const char* pfm_path;
+    const char* scene_path;
+    const char* trace_path;
+    uint64_t seed;
+    float error_threshold;
+    Integrator integrator;
+    SamplerType sampler_type;
+    TriangleLayout triangle_layout;
+    int max_depth;
+    int max_samples;
+    int min_samples;
+    int passes;
+    int roulette_depth;
+    int samples_per_pass;
+    int threads_count;
+    int time_limit;
+    bool pin_threads;
+    bool show_help;
+} Settings;
+
+// Accepts a single number for a square, or a width and height like 1280x720.
+static bool parse_dimensions(const char* text, Int2* dimensions)
 {
-    if(x <= 0.0031308f)
+    char* end;
+    long width = strtol(text, &end, 10);
+    long height = width;
+    if(*end == 'x')
     {
-        return x * 12.92f;
+        const char* height_text = end + 1;
+        height = strtol(height_text, &end, 10);
+        if(end == height_text)
+        {
+            return false;
+        }
     }
-    else
+
+    if(end == text || *end || width <= 0 || height <= 0 || width > INT_MAX / height)
     {
-        return 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+        return false;
     }
-}
 
-static Float3 linear_to_srgb(Float3 colour)
-{
-    Float3 result;
-    result.x = linear_to_srgb_component(colour.x);
-    result.y = linear_to_srgb_component(colour.y);
-    result.z = linear_to_srgb_component(colour.z);
-    return result;
-}
+    dimensions->x = (int) width;
+    dimensions->y = (int) height;
 
-static Float3 float3_clamp_unorm(Float3 v)
-{
-    Float3 result;
-    result.x = fmaxf(fminf(v.x, 1.0f), 0.0f);
-    result.y = fmaxf(fminf(v.y, 1.0f), 0.0f);
-    result.z = fmaxf(fminf(v.z, 1.0f), 0.0f);
-    return result;
+    return true;
 }
 
-MaybeFloat intersect_ray_plane(Ray ray, Plane plane)
+// The whole of the text has to be a number no less than min.
+static bool parse_int(const char* text, int min, int* value)
 {
-    MaybeFloat result;
-    result.valid = false;
-
-    float d = float3_dot(plane.normal, ray.direction);
-
-    if(fabsf(d) > 1e-6f)
+    char* end;
+    errno = 0;
+    long result = strtol(text, &end, 10);
+    if(end == text || *end || errno == ERANGE || result < min || result > INT_MAX)
     {
-        float t = (-float3_dot(ray.origin, plane.normal) - plane.d) / d;
-        result.valid = t >= 0.0f;
-        result.value = t;
+        return false;
     }
 
-    return result;
+    *value = (int) result;
+
+    return true;
 }
 
-MaybeFloat intersect_ray_sphere(Ray ray, Sphere sphere)
+static bool parse_float(const char* text, float* value)
 {
-    MaybeFloat result;
-    result.valid = false;
-
-    float radius2 = sphere.radius * sphere.radius;
-    Float3 l = float3_subtract(sphere.center, ray.origin);
-    float tca = float3_dot(l, ray.direction);
-
-    if(tca < 0.0f)
-    {
-        return result;
-    }
-
-    float d2 = float3_squared_length(l) - (tca * tca);
-
-    if(d2 > radius2)
-    {
-        return result;
-    }
-
-    float thc = sqrtf(radius2 - d2);
-
-    float t[2];
-    t[0] = tca - thc;
-    t[1] = tca + thc;
-
-    if(t[0] > t[1])
-    {
-        float temp = t[0];
-        t[0] = t[1];
-        t[1] = temp;
-    }
-
-    if(t[0] < 0.0f)
+    char* end;
+    errno = 0;
+    float result = strtof(text, &end);
+    if(end == text || *end || errno == ERANGE || !isfinite(result))
     {
-        t[0] = t[1];
-
-        if(t[0] < 0.0f)
-        {
-            return result;
-        }
+        return false;
     }
 
-    result.valid = true;
-    result.value = t[0];
+    *value = result;
 
-    return result;
+    return true;
 }
 
-MaybeFloat intersect_ray_triangle(Ray ray, Triangle triangle)
+// strtoull would quietly wrap a negative number around, so the text has to
+// start with a digit.
+static bool parse_uint64(const char* text, uint64_t* value)
 {
-    MaybeFloat result;
-    result.valid = false;
-
-    Float3 edges[2];
-    edges[0] = float3_subtract(triangle.vertices[1], triangle.vertices[0]);
-    edges[1] = float3_subtract(triangle.vertices[2], triangle.vertices[0]);
-
-    Float3 p = float3_cross(ray.direction, edges[1]);
-    float determinant = float3_dot(edges[0], p);
-
-    if(fabsf(determinant) < 1e-6f)
-    {
-        return result;
-    }
-
-    float inv_det = 1.0f / determinant;
-
-    Float3 s = float3_subtract(ray.origin, triangle.vertices[0]);
-    float u = inv_det * float3_dot(s, p);
-    if(u < 0.0f || u > 1.0f)
-    {
-        return result;
-    }
-
-    Float3 q = float3_cross(s, edges[0]);
-    float v = inv_det * float3_dot(ray.direction, q);
-    if(v < 0.0f || u + v > 1.0f)
+    char* end;
+    errno = 0;
+    unsigned long long result = strtoull(text, &end, 10);
+    if(end == text || *end || errno == ERANGE || text[0] < '0' || text[0] > '9')
     {
-        return result;
+        return false;
     }
 
-    float t = inv_det * float3_dot(edges[1], q);
-
-    result.valid = true;
-    result.value = t;
-
-    return result;
-}
-
-Float3 get_random_direction(RandomGenerator* generator)
-{
-    Float3 result;
-    result.x = random_float_range(generator, -1.0f, 1.0f);
-    result.y = random_float_range(generator, -1.0f, 1.0f);
-    result.z = random_float_range(generator, -1.0f, 1.0f);
+    *value = (uint64_t) result;
 
-    return float3_normalise(result);
+    return true;
 }
 
-Float3 trace_path(Ray ray, World* world, RandomGenerator* generator, int depth)
+static bool parse_settings(Settings* settings, int argc, const char** argv)
 {
-    const int max_depth = 4;
-
-    if(depth >= max_depth)
-    {
-        Material material = world->materials[0];
-        return material.emittance;
-    }
-
-    const float min_hit_distance = 0.0001f;
-    float hit_distance = FLT_MAX;
-    int hit_material_index = 0;
-    Float3 hit_normal = float3_unit_z;
-
-    for(int mesh_index = 0;
-            mesh_index < world->meshes_count;
-            mesh_index += 1)
+    settings->integrator = INTEGRATOR_MEGAKERNEL;
+    settings->triangle_layout = TRIANGLE_LAYOUT_EDGES;
+    settings->dimensions.x = 1280;
+    settings->dimensions.y = 720;
+    settings->tile_dimensions.x = 32;
+    settings->tile_dimensions.y = 32;
+    settings->samples_per_pass = 4;
+    settings->passes = 0;
+    settings->time_limit = 0;
+    settings->error_threshold = 0.0f;
+    settings->max_samples = 1024;
+    settings->min_samples = 8;
+    settings->max_depth = 16;
+    settings->roulette_depth = 3;
+    settings->threads_count = get_logical_core_count();
+    settings->output_path = "test.bmp";
+    settings->scene_path = NULL;
+    settings->pfm_path = NULL;
+    settings->trace_path = NULL;
+    settings->seed = 0;
+    settings->sampler_type = SAMPLER_TYPE_SOBOL;
+    settings->pin_threads = false;
+    settings->show_help = false;
+
+    for(int arg_index = 1; arg_index < argc; arg_index += 1)
     {
-        Mesh mesh = world->meshes[mesh_index];
-
-        for(int triangle_index = 0;
-                triangle_index < mesh.triangles_count;
-                triangle_index += 1)
+        if(strcmp(argv[arg_index], "--integrator") == 0 && arg_index + 1 < argc)
         {
-            Triangle triangle = mesh.triangles[triangle_index];
-
-            Float3 triangle_normal = float3_normalise(float3_cross(float3_subtract(triangle.vertices[1], triangle.vertices[0]), float3_subtract(triangle.vertices[2], triangle.vertices[0])));
-            if(float3_dot(float3_subtract(ray.origin, triangle.vertices[0]), triangle_normal) < 0.0f)
+            arg_index += 1;
+            if(strcmp(argv[arg_index], "wavefront") == 0)
             {
-                triangle_normal = float3_negate(triangle_normal);
+                settings->integrator = INTEGRATOR_WAVEFRONT;
             }
-
-            MaybeFloat intersection = intersect_ray_triangle(ray, triangle);
-
-            if(intersection.valid)
+            else if(strcmp(argv[arg_index], "megakernel") == 0)
             {
-                float distance = intersection.value;
-
-                if(distance > min_hit_distance && distance < hit_distance)
-                {
-                    hit_material_index = mesh.material_index;
-                    hit_distance = distance;
-                    hit_normal = triangle_normal;
-                }
+                settings->integrator = INTEGRATOR_MEGAKERNEL;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown integrator %s.\n", argv[arg_index]);
+                return false;
             }
         }
-    }
-
-    for(int plane_index = 0;
-            plane_index < world->planes_count;
-            plane_index += 1)
-    {
-        Plane plane = world->planes[plane_index];
-
-        MaybeFloat intersection = intersect_ray_plane(ray, plane);
-
-        if(intersection.valid)
+        else if(strcmp(argv[arg_index], "--triangle-test") == 0 && arg_index + 1 < argc)
         {
-            float distance = intersection.value;
-
-            if(distance > min_hit_distance && distance < hit_distance)
+            arg_index += 1;
+            if(strcmp(argv[arg_index], "woop") == 0)
+            {
+                settings->triangle_layout = TRIANGLE_LAYOUT_WOOP;
+            }
+            else if(strcmp(argv[arg_index], "moller-trumbore") == 0)
+            {
+                settings->triangle_layout = TRIANGLE_LAYOUT_EDGES;
+            }
+            else
             {
-                hit_material_index = plane.material_index;
-                hit_distance = distance;
-                hit_normal = plane.normal;
+                fprintf(stderr, "Unknown triangle test %s.\n", argv[arg_index]);
+                return false;
             }
         }
-    }
-
-    for(int sphere_index = 0;
-            sphere_index < world->spheres_count;
-            sphere_index += 1)
-    {
-        Sphere sphere = world->spheres[sphere_index];
-
-        MaybeFloat intersection = intersect_ray_sphere(ray, sphere);
-
-        if(intersection.valid)
+        else if(strcmp(argv[arg_index], "--size") == 0 && arg_index + 1 < argc)
         {
-            float distance = intersection.value;
-
-            if(distance > min_hit_distance && distance < hit_distance)
+            arg_index += 1;
+            if(!parse_dimensions(argv[arg_index], &settings->dimensions))
             {
-                hit_material_index = sphere.material_index;
-                hit_distance = distance;
-
-                Float3 hit_point = float3_add(float3_multiply(hit_distance, ray.direction), ray.origin);
-                hit_normal = float3_normalise(float3_subtract(hit_point, sphere.center));
+                fprintf(stderr, "Image size should be a width and height in pixels, like 1280x720.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--tile-size") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_dimensions(argv[arg_index], &settings->tile_dimensions))
+            {
+                fprintf(stderr, "Tile size should be a positive number of pixels, or a width and height like 32x16.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--threads") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 1, &settings->threads_count))
+            {
+                fprintf(stderr, "Threads must be a positive number.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--pin-threads") == 0)
+        {
+            settings->pin_threads = true;
+        }
+        else if(strcmp(argv[arg_index], "--output") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            settings->output_path = argv[arg_index];
+        }
+        else if(strcmp(argv[arg_index], "--samples") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 1, &settings->samples_per_pass))
+            {
+                fprintf(stderr, "Samples per pass must be a positive number.\n");
+                return false;
             }
         }
+        else if(strcmp(argv[arg_index], "--passes") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 1, &settings->passes))
+            {
+                fprintf(stderr, "Passes must be a positive number.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--time-limit") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 1, &settings->time_limit))
+            {
+                fprintf(stderr, "Time limit must be a positive number of seconds.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--adaptive") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_float(argv[arg_index], &settings->error_threshold) || settings->error_threshold <= 0.0f)
+            {
+                fprintf(stderr, "Adaptive error threshold must be positive.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--sampler") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(strcmp(argv[arg_index], "random") == 0)
+            {
+                settings->sampler_type = SAMPLER_TYPE_RANDOM;
+            }
+            else if(strcmp(argv[arg_index], "halton") == 0)
+            {
+                settings->sampler_type = SAMPLER_TYPE_HALTON;
+            }
+            else if(strcmp(argv[arg_index], "sobol") == 0)
+            {
+                settings->sampler_type = SAMPLER_TYPE_SOBOL;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown sampler %s.\n", argv[arg_index]);
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--seed") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_uint64(argv[arg_index], &settings->seed))
+            {
+                fprintf(stderr, "Seed must be a number that's zero or more.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--min-samples") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 2, &settings->min_samples))
+            {
+                fprintf(stderr, "Min samples must be at least 2.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--max-samples") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 2, &settings->max_samples))
+            {
+                fprintf(stderr, "Max samples must be at least 2.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--scene") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            settings->scene_path = argv[arg_index];
+        }
+        else if(strcmp(argv[arg_index], "--pfm") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            settings->pfm_path = argv[arg_index];
+        }
+        else if(strcmp(argv[arg_index], "--trace") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            settings->trace_path = argv[arg_index];
+            if(!profile_is_enabled())
+            {
+                fprintf(stderr, "Tracing needs a build with the PROFILE option on.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--max-depth") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 0, &settings->max_depth))
+            {
+                fprintf(stderr, "Max depth must be a number that's zero or more.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--roulette-depth") == 0 && arg_index + 1 < argc)
+        {
+            arg_index += 1;
+            if(!parse_int(argv[arg_index], 0, &settings->roulette_depth))
+            {
+                fprintf(stderr, "Roulette depth must be a number that's zero or more.\n");
+                return false;
+            }
+        }
+        else if(strcmp(argv[arg_index], "--help") == 0)
+        {
+            settings->show_help = true;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s.\n", argv[arg_index]);
+            return false;
+        }
     }
 
-    if(!hit_material_index)
+    if(settings->min_samples > settings->max_samples)
     {
-        Material material = world->materials[hit_material_index];
-        return material.emittance;
+        fprintf(stderr, "Min samples can't be more than max samples.\n");
+        return false;
     }
 
-    Material material = world->materials[hit_material_index];
-
-    Float3 pure_bounce = float3_normalise(float3_reflect(ray.direction, hit_normal));
-    Float3 random_direction = get_random_direction(generator);
-    Float3 scatter_bounce = float3_normalise(float3_add(hit_normal, random_direction));
-
-    ray.origin = float3_add(float3_multiply(hit_distance, ray.direction), ray.origin);
-    ray.direction = float3_normalise(float3_lerp(scatter_bounce, pure_bounce, material.glossiness));
-
-    const float p = 1.0f / (2.0f * M_PI);
-    float cos_theta = float3_dot(ray.direction, hit_normal);
-    Float3 brdf = float3_divide(material.reflectance, M_PI);
-
-    Float3 incoming = trace_path(ray, world, generator, depth + 1);
-
-    Float3 radiance = float3_multiply(cos_theta / p, float3_pointwise_multiply(brdf, incoming));
+    // Adaptive sampling keeps going until every pixel converges, unless told
+    // otherwise.
+    if(settings->passes == 0)
+    {
+        settings->passes = settings->error_threshold > 0.0f ? INT_MAX : 1;
+    }
 
-    return float3_add(radiance, material.emittance);
+    return true;
 }
 
-void render_tile(void* parameter)
+static void print_usage(FILE* file)
 {
-    Tile* tile = parameter;
-    Image* image = tile->image;
+    fprintf(file,
+        "Usage: PathTracer [options]\n"
+        "\n"
+        "  --scene PATH             Scene file to render, or the demo scene if not given.\n"
+        "  --size WxH               Image width and height in pixels. (1280x720)\n"
+        "  --output PATH            Bitmap written after every pass. (test.bmp)\n"
+        "  --pfm PATH               Also write linear radiance as a float map.\n"
+        "  --samples N              Samples per pixel in each pass. (4)\n"
+        "  --passes N               Number of passes. (1, or until converged if adaptive)\n"
+        "  --time-limit SECONDS     Stop after the pass that runs past this.\n"
+        "  --adaptive THRESHOLD     Stop sampling pixels once their error is below this.\n"
+        "  --min-samples N          Fewest samples an adaptive pixel gets. (8)\n"
+        "  --max-samples N          Most samples an adaptive pixel gets. (1024)\n"
+        "  --threads N              Threads rendering, including the main one. (all cores)\n"
+        "  --pin-threads            Keep each thread on one core, spread over memory nodes.\n"
+        "  --tile-size N or WxH     Size of the tiles threads take at a time. (32)\n"
+        "  --integrator NAME        megakernel or wavefront. (megakernel)\n"
+        "  --sampler NAME           random, halton or sobol. (sobol)\n"
+        "  --seed N                 Seed for every sample in the image. (0)\n"
+        "  --max-depth N            Most bounces a path takes. (16)\n"
+        "  --roulette-depth N       Bounces before paths can be cut short. (3)\n"
+        "  --triangle-test NAME     moller-trumbore or woop. (moller-trumbore)\n"
+        "  --trace PATH             Save a timeline of the render, in builds with PROFILE on.\n"
+        "  --help                   Show this list.\n");
+}
 
-    RandomGenerator generator;
-    random_seed_by_time(&generator);
+int main(int argc, const char** argv)
+{
+    Settings settings;
+    if(!parse_settings(&settings, argc, argv))
+    {
+        print_usage(stderr);
+        return 1;
+    }
 
-    Rect region = tile->image_region;
-    int left = region.bottom_left.x;
-    int right = region.bottom_left.x + region.dimensions.x;
-    int bottom = region.bottom_left.y;
-    int top = region.bottom_left.y + region.dimensions.y;
+    if(settings.show_help)
+    {
+        print_usage(stdout);
+        return 0;
+    }
 
-    Camera* camera = tile->camera;
-    Matrix4 view = matrix4_look_at(camera->position, camera->target, float3_unit_z);
-    Matrix4 inverse_view = matrix4_inverse_view(view);
+    int threads_count = settings.threads_count;
 
-    float aspect_ratio = image->dimensions.x / (float) image->dimensions.y;
-    float scale_y = tanf(0.5f * camera->field_of_view);
-    float scale_x = aspect_ratio * scale_y;
+    PROFILE_THREAD_START("main");
 
-    float half_pixel_width = scale_x * 0.5f / image->dimensions.x;
-    float half_pixel_height = scale_y * 0.5f / image->dimensions.y;
+    // Everything long-lived comes from the heap through a tracker, so peak
+    // memory use can be reported at the end.
+    Allocator tracker;
+    tracker_create(&tracker, NULL);
 
-    const int samples_per_pixel = 4;
+    // Pinned threads are dealt out over the cores so that each memory node
+    // gets its share, and the image is split into a band per node in use.
+    CpuPlacement* placements = NULL;
+    int bands_count = 1;
 
-    for(int y = bottom; y < top; y += 1)
+    if(settings.pin_threads)
     {
-        float film_y = 2.0f * ((y + 0.5f) / image->dimensions.y) - 1.0f;
-        film_y *= scale_y;
-
-        for(int x = left; x < right; x += 1)
+        placements = allocate(&tracker, sizeof(CpuPlacement) * threads_count);
+        int placements_count = placements ? get_cpu_placements(placements, threads_count) : 0;
+        if(placements_count == 0)
         {
-            float film_x = 2.0f * ((x + 0.5f) / image->dimensions.x) - 1.0f;
-            film_x *= scale_x;
-
-            Float3 film_point = {film_x, film_y, -1.0f};
-
-            Float3 colour = float3_zero;
-            float contribution = 1.0f / samples_per_pixel;
+            fprintf(stderr, "Couldn't find which cores to pin threads to.\n");
+            deallocate(&tracker, placements, sizeof(CpuPlacement) * threads_count);
+            return 1;
+        }
 
-            for(int sample_count = 0;
-                    sample_count < samples_per_pixel;
-                    sample_count += 1)
+        for(int thread_index = 0; thread_index < threads_count; thread_index += 1)
+        {
+            placements[thread_index] = placements[thread_index % placements_count];
+            if(placements[thread_index].node >= bands_count)
             {
-                Float3 jitter;
-                jitter.x = random_float_range(&generator, -half_pixel_width, half_pixel_width);
-                jitter.y = random_float_range(&generator, -half_pixel_height, half_pixel_height);
-                jitter.z = 0.0f;
-
-                Float3 jittered_point = float3_add(film_point, jitter);
-                Float3 ray_point = matrix4_transform_point(inverse_view, jittered_point);
-
-                Ray ray;
-                ray.origin = camera->position;
-                ray.direction = float3_normalise(float3_subtract(ray_point, ray.origin));
-
-                Float3 sample = trace_path(ray, tile->world, &generator, 0);
-                colour = float3_add(colour, float3_multiply(contribution, sample));
+                bands_count = placements[thread_index].node + 1;
             }
-
-            colour = float3_clamp_unorm(colour);
-            Float3 srgb_colour = linear_to_srgb(colour);
-            uint32_t pixel_value = rgb_to_uint32(srgb_colour);
-
-            image->pixels[(image->dimensions.x * y) + x].value = pixel_value;
         }
-    }
-}
 
-int main(int argc, const char** argv)
-{
-    int cores = get_logical_core_count();
+        pin_current_thread(placements[0]);
+        printf("Pinned %i threads over %i memory nodes.\n", threads_count, bands_count);
+    }
 
-    ThreadPool* pool = thread_pool_create(NULL, cores - 1);
+    ThreadPool* pool = thread_pool_create(&tracker, threads_count - 1, placements ? placements + 1 : NULL);
 
     if(!pool)
     {
         fprintf(stderr, "Pool not created!\n");
+        deallocate(&tracker, placements, sizeof(CpuPlacement) * threads_count);
+        return 1;
     }
     else
     {
-        printf("Thread pool created with %i threads.\n", cores - 1);
+        printf("Thread pool created with %i threads.\n", threads_count - 1);
 
-        Camera camera =
-        {
-            .position = {0.0f, -5.0f, 1.0f},
-            .target = float3_zero,
-            .field_of_view = (float) M_PI_4,
-        };
+        Camera camera;
+        World world;
+        world_create(&world, &tracker);
+        world.triangle_layout = settings.triangle_layout;
 
-        Material background =
+        bool world_built;
+        if(settings.scene_path)
         {
-            .emittance = {0.3f, 0.4f, 0.5f},
-        };
-
-        Material red =
+            clock_t load_start = clock();
+            bool loaded_from_cache;
+            world_built = scene_load(&world, &camera, settings.scene_path, &loaded_from_cache);
+            double load_milliseconds = 1000.0 * (double) (clock() - load_start) / CLOCKS_PER_SEC;
+            if(world_built)
+            {
+                printf("Loaded %s %s in %.1f ms.\n", settings.scene_path, loaded_from_cache ? "from its cache" : "from text", load_milliseconds);
+            }
+        }
+        else
         {
-            .reflectance = {0.5f, 0.5f, 0.5f},
-        };
+            world_built = scene_create_demo(&world, &camera);
+            if(!world_built)
+            {
+                fprintf(stderr, "Failed to build the bounding volume hierarchy.\n");
+            }
+        }
 
-        Material cyan =
+        if(!world_built)
         {
-            .reflectance = {0.7f, 0.5f, 0.3f},
-        };
+            world_destroy(&world);
+            thread_pool_destroy(pool);
+            return 1;
+        }
 
-        Material boyfriend_material =
+        BvhStatistics statistics = bvh_compute_statistics(&world.bvh);
+        printf("BVH built over %i primitives: %i nodes, %i leaves, depth %i.\n",
+            world.primitives_count, statistics.nodes_count, statistics.leaves_count, statistics.depth);
+        printf("BVH leaf sizes: min %i, max %i, average %.2f, average leaf depth %.2f, SAH cost %.2f.\n",
+            statistics.min_leaf_size, statistics.max_leaf_size, statistics.average_leaf_size,
+            statistics.average_leaf_depth, statistics.sah_cost);
+        printf("BVH leaf size histogram:");
+        for(int bucket = 0; bucket < BVH_MAX_LEAF_PRIMITIVES; bucket += 1)
         {
-            .reflectance = {0.7f, 0.5f, 0.3f},
-            .glossiness = 0.7f,
-        };
+            printf(" %i:%i", bucket + 1, statistics.leaf_size_histogram[bucket]);
+        }
+        printf(" >%i:%i\n", BVH_MAX_LEAF_PRIMITIVES, statistics.leaf_size_histogram[BVH_MAX_LEAF_PRIMITIVES]);
+        printf("Using %s intersection kernels.\n", simd_level_name(world.kernels.level));
+        printf("Using the %s sampler.\n", sampler_type_name(settings.sampler_type));
 
-        Plane plane =
-        {
-            .normal = float3_unit_z,
-            .d = 0.0f,
-            .material_index = 1,
-        };
+        Image image;
+        image.allocator = &tracker;
+        image.dimensions = settings.dimensions;
+        image.pixels = allocate(&tracker, sizeof(PixelU32) * image.dimensions.x * image.dimensions.y);
 
-        Sphere sphere =
-        {
-            .center = {1.0f, 0.0f, 1.0f},
-            .radius = 1.0f,
-            .material_index = 2,
-        };
+        AccumulationBuffer accumulation;
+        bool accumulation_created = accumulation_buffer_create(&accumulation, image.dimensions, &tracker);
 
-        Sphere small_fella =
-        {
-            .center = {-1.0f, -2.0f, 0.0f},
-            .radius = 0.5f,
-            .material_index = 3,
-        };
+        TileSchedule schedule;
+        bool schedule_created = tile_schedule_create(&schedule, image.dimensions, settings.tile_dimensions, bands_count, &tracker);
 
-        Sphere yo =
-        {
-            .center = {-2.0f, 3.0f, 1.5f},
-            .radius = 1.0f,
-            .material_index = 3,
-        };
+        RenderCounters* thread_counters = allocate(&tracker, sizeof(RenderCounters) * threads_count);
 
-        Sphere hi =
+        if(!image.pixels || !accumulation_created || !schedule_created || !thread_counters)
         {
-            .center = {1.0f, -3.0f, 0.5f},
-            .radius = 0.6f,
-            .material_index = 3,
-        };
+            fprintf(stderr, "Failed to allocate the image.\n");
+            deallocate(&tracker, thread_counters, sizeof(RenderCounters) * threads_count);
+            tile_schedule_destroy(&schedule);
+            accumulation_buffer_destroy(&accumulation);
+            image_destroy(&image);
+            world_destroy(&world);
+            thread_pool_destroy(pool);
+            return 1;
+        }
 
-        Mesh triang =
+        schedule.accumulation = &accumulation;
+        schedule.camera = &camera;
+        schedule.world = &world;
+        schedule.seed = settings.seed;
+        schedule.integrator = settings.integrator;
+        schedule.sampler_type = settings.sampler_type;
+        schedule.max_depth = settings.max_depth;
+        schedule.roulette_depth = settings.roulette_depth;
+        schedule.samples_per_pixel = settings.samples_per_pass;
+        schedule.max_samples = settings.error_threshold > 0.0f ? settings.max_samples : 0;
+        schedule.thread_counters = thread_counters;
+        schedule.thread_counters_count = threads_count;
+
+        time_t start_time = time(NULL);
+        double render_start = get_time_seconds();
+        double render_seconds = 0.0;
+
+        for(int pass_index = 0; pass_index < settings.passes; pass_index += 1)
         {
-            .triangles[0].vertices[0] = {-0.5f, -3.0f, 0.0f},
-            .triangles[0].vertices[2] = {1.0f, -2.0f, 0.0f},
-            .triangles[0].vertices[1] = {-0.5f, -3.0f, 1.0f},
-            .triangles_count = 1,
-            .material_index = 3,
-        };
+            int tiles_count = tile_schedule_restart(&schedule);
+            if(tiles_count == 0)
+            {
+                break;
+            }
+
+            // Every thread, including this one, keeps taking tiles until
+            // there are none left.
+            for(int thread_index = 0;
+                    thread_index < threads_count - 1;
+                    thread_index += 1)
+            {
+                Task task =
+                {
+                    .call = render_tiles,
+                    .parameter = &schedule,
+                };
+                thread_pool_add_task(pool, task);
+            }
 
-        World world = {0};
-        world.materials_count = 3;
-        world.materials[0] = background;
-        world.materials[1] = red;
-        world.materials[2] = cyan;
-        world.materials[3] = boyfriend_material;
-        world.meshes_count = 1;
-        world.meshes[0] = triang;
-        world.planes_count = 1;
-        world.planes[0] = plane;
-        world.spheres_count = 4;
-        world.spheres[0] = sphere;
-        world.spheres[1] = small_fella;
-        world.spheres[2] = yo;
-        world.spheres[3] = hi;
+            render_tiles(&schedule);
 
-        Image image;
-        image.dimensions.x = 1280;
-        image.dimensions.y = 720;
-        image.pixels = allocate(NULL, sizeof(PixelU32) * image.dimensions.x * image.dimensions.y);
+            thread_pool_wait_all(pool);
 
-        Tile tiles[16];
-        for(int y = 0; y < 4; y += 1)
-        {
-            for(int x = 0; x < 4; x += 1)
+            render_seconds += get_time_seconds() - render_start;
+
+            accumulation.passes_count += 1;
+
+            int pixels_count = image.dimensions.x * image.dimensions.y;
+            int active_pixels_count = pixels_count;
+            if(settings.error_threshold > 0.0f)
             {
-                Tile* tile = &tiles[(4 * y) + x];
-                tile->camera = &camera;
-                tile->image = &image;
-                tile->world = &world;
+                active_pixels_count = accumulation_buffer_update_convergence(&accumulation, settings.error_threshold, settings.min_samples, settings.max_samples);
+            }
 
-                Int2 tile_dimensions = int2_divide(image.dimensions, 4);
-                Int2 bottom_left = {x, y};
-                tile->image_region.bottom_left = int2_pointwise_multiply(bottom_left, tile_dimensions);
-                tile->image_region.dimensions = tile_dimensions;
+            // Write out every pass so that the latest image is always on disk.
+            accumulation_buffer_resolve(&accumulation, &image);
+            if(!bmp_write_file(settings.output_path, (uint8_t*) image.pixels, image.dimensions.x, image.dimensions.y))
+            {
+                fprintf(stderr, "Failed to write %s.\n", settings.output_path);
+            }
+            if(settings.pfm_path && !pfm_write_file(settings.pfm_path, image.dimensions.x, image.dimensions.y, resolve_row, &accumulation, &tracker))
+            {
+                fprintf(stderr, "Failed to write %s.\n", settings.pfm_path);
             }
-        }
 
-        for(int work_index = 0;
-                work_index < 15;
-                work_index += 1)
-        {
-            Task task =
+            int64_t samples_total = 0;
+            for(int pixel_index = 0; pixel_index < pixels_count; pixel_index += 1)
             {
-                .call = render_tile,
-                .parameter = &tiles[work_index],
-            };
-            thread_pool_add_task(pool, task);
-        }
+                samples_total += accumulation.samples_counts[pixel_index];
+            }
+
+            double elapsed = difftime(time(NULL), start_time);
+            printf("Pass %i done on %i tiles, %.2f samples per pixel, ", pass_index + 1, tiles_count, samples_total / (double) pixels_count);
+            if(settings.error_threshold > 0.0f)
+            {
+                printf("%i pixels unconverged, ", active_pixels_count);
+            }
+            printf("%.0f seconds.\n", elapsed);
 
-        render_tile(&tiles[15]);
+            if(settings.time_limit > 0 && elapsed >= settings.time_limit)
+            {
+                break;
+            }
 
-        thread_pool_wait_all(pool);
+            render_start = get_time_seconds();
+        }
 
-        bmp_write_file("test.bmp", (uint8_t*) image.pixels, image.dimensions.x, image.dimensions.y, NULL);
+        uint64_t rays_count = 0;
+        for(int thread_index = 0; thread_index < threads_count; thread_index += 1)
+        {
+            RenderCounters* counters = &thread_counters[thread_index];
+            rays_count += counters->closest_hit_rays + counters->shadow_rays;
+        }
+        printf("Traced %.1f million rays in %.2f seconds, %.2f million rays per second.\n",
+            rays_count / 1e6, render_seconds, rays_count / (1e6 * render_seconds));
 
+        deallocate(&tracker, thread_counters, sizeof(RenderCounters) * threads_count);
+        tile_schedule_destroy(&schedule);
+        accumulation_buffer_destroy(&accumulation);
         image_destroy(&image);
+        world_destroy(&world);
     }
 
     thread_pool_destroy(pool);
+    deallocate(&tracker, placements, sizeof(CpuPlacement) * threads_count);
+
+    profile_print_counters(stdout);
+    if(settings.trace_path && !profile_write_trace(settings.trace_path))
+    {
+        fprintf(stderr, "Failed to write the trace %s.\n", settings.trace_path);
+    }
+    profile_destroy();
+
+    uint64_t bytes;
+    uint64_t peak_bytes;
+    uint64_t allocations_count;
+    uint64_t deallocations_count;
+    tracker_get_counts(&tracker, &bytes, &peak_bytes, &allocations_count, &deallocations_count);
+    printf("Peak memory use %.1f MiB over %llu allocations, %llu bytes left allocated.\n",
+        peak_bytes / (1024.0 * 1024.0), (unsigned long long) allocations_count, (unsigned long long) bytes);
 
     return 0;
 }
@@ -1,43 +1,678 @@
 #include "memory.h"
 
+#include "assert.h"
+
+#include <stddef.h>
 #include <stdlib.h>
 
-void* allocate(Allocator* allocator, uint64_t bytes)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Both copying and zeroing work in 16-byte chunks, four at a time, with
+// aligned stores. Only the few bytes before the destination is aligned and
+// after the last whole chunk are done one at a time. SSE2 is used where it's
+// always available, and pairs of 64-bit words elsewhere.
+
+#if defined(USE_SSE2)
+
+typedef __m128i Chunk;
+
+static Chunk load_chunk(const uint8_t* from)
+{
+    return _mm_loadu_si128((const __m128i*) from);
+}
+
+static void store_chunk(uint8_t* to, Chunk chunk)
+{
+    _mm_store_si128((__m128i*) to, chunk);
+}
+
+static Chunk zero_chunk(void)
+{
+    return _mm_setzero_si128();
+}
+
+#else
+
+#if defined(__GNUC__)
+typedef uint64_t __attribute__((may_alias)) Word;
+#else
+typedef uint64_t Word;
+#endif
+
+typedef struct Chunk
 {
-    return calloc(bytes, 1);
+    Word words[2];
+} Chunk;
+
+static Chunk load_chunk(const uint8_t* from)
+{
+    const Word* words = (const Word*) from;
+    Chunk chunk = {{words[0], words[1]}};
+    return chunk;
+}
+
+static void store_chunk(uint8_t* to, Chunk chunk)
+{
+    Word* words = (Word*) to;
+    words[0] = chunk.words[0];
+    words[1] = chunk.words[1];
 }
 
+static Chunk zero_chunk(void)
+{
+    Chunk chunk = {{0, 0}};
+    return chunk;
+}
+
+#endif
+
+#define CHUNK_SIZE 16
+
+static uint64_t bytes_to_alignment(const uint8_t* p)
+{
+    return (CHUNK_SIZE - ((uintptr_t) p & (CHUNK_SIZE - 1))) & (CHUNK_SIZE - 1);
+}
+
+// Every group of chunks is loaded before any of it is stored, so copying
+// forwards is safe when the destination overlaps the source from below.
+static void copy_forwards(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t head = bytes_to_alignment(to);
+    if(head > bytes)
+    {
+        head = bytes;
+    }
+    for(uint64_t index = 0; index < head; index += 1)
+    {
+        to[index] = from[index];
+    }
+    to += head;
+    from += head;
+    bytes -= head;
+
+    for(; bytes >= 4 * CHUNK_SIZE; bytes -= 4 * CHUNK_SIZE)
+    {
+        Chunk c0 = load_chunk(from);
+        Chunk c1 = load_chunk(from + CHUNK_SIZE);
+        Chunk c2 = load_chunk(from + (2 * CHUNK_SIZE));
+        Chunk c3 = load_chunk(from + (3 * CHUNK_SIZE));
+        store_chunk(to, c0);
+        store_chunk(to + CHUNK_SIZE, c1);
+        store_chunk(to + (2 * CHUNK_SIZE), c2);
+        store_chunk(to + (3 * CHUNK_SIZE), c3);
+        to += 4 * CHUNK_SIZE;
+        from += 4 * CHUNK_SIZE;
+    }
+
+    for(; bytes >= CHUNK_SIZE; bytes -= CHUNK_SIZE)
+    {
+        store_chunk(to, load_chunk(from));
+        to += CHUNK_SIZE;
+        from += CHUNK_SIZE;
+    }
+
+    for(uint64_t index = 0; index < bytes; index += 1)
+    {
+        to[index] = from[index];
+    }
+}
+
+// The mirror image of copy_forwards, for a destination that overlaps the
+// source from above.
+static void copy_backwards(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    to += bytes;
+    from += bytes;
+
+    uint64_t tail = (uintptr_t) to & (CHUNK_SIZE - 1);
+    if(tail > bytes)
+    {
+        tail = bytes;
+    }
+    for(uint64_t index = 0; index < tail; index += 1)
+    {
+        to -= 1;
+        from -= 1;
+        *to = *from;
+    }
+    bytes -= tail;
+
+    for(; bytes >= 4 * CHUNK_SIZE; bytes -= 4 * CHUNK_SIZE)
+    {
+        to -= 4 * CHUNK_SIZE;
+        from -= 4 * CHUNK_SIZE;
+        Chunk c0 = load_chunk(from);
+        Chunk c1 = load_chunk(from + CHUNK_SIZE);
+        Chunk c2 = load_chunk(from + (2 * CHUNK_SIZE));
+        Chunk c3 = load_chunk(from + (3 * CHUNK_SIZE));
+        store_chunk(to + (3 * CHUNK_SIZE), c3);
+        store_chunk(to + (2 * CHUNK_SIZE), c2);
+        store_chunk(to + CHUNK_SIZE, c1);
+        store_chunk(to, c0);
+    }
+
+    for(; bytes >= CHUNK_SIZE; bytes -= CHUNK_SIZE)
+    {
+        to -= CHUNK_SIZE;
+        from -= CHUNK_SIZE;
+        store_chunk(to, load_chunk(from));
+    }
+
+    for(; bytes; bytes -= 1)
+    {
+        to -= 1;
+        from -= 1;
+        *to = *from;
+    }
+}
+
+// Regions may overlap.
 void copy_memory(void* to, const void* from, uint64_t bytes)
 {
     const uint8_t* p0 = from;
     uint8_t* p1 = to;
-    if(p0 < p1)
+    if(p0 < p1 && p1 < p0 + bytes)
     {
-        for(p0 += bytes, p1 += bytes; bytes; bytes -= 1)
+        copy_backwards(p1, p0, bytes);
+    }
+    else
+    {
+        copy_forwards(p1, p0, bytes);
+    }
+}
+
+void zero_memory(void* memory, uint64_t bytes)
+{
+    uint8_t* p = memory;
+
+    uint64_t head = bytes_to_alignment(p);
+    if(head > bytes)
+    {
+        head = bytes;
+    }
+    for(uint64_t index = 0; index < head; index += 1)
+    {
+        p[index] = 0;
+    }
+    p += head;
+    bytes -= head;
+
+    Chunk zero = zero_chunk();
+
+    for(; bytes >= 4 * CHUNK_SIZE; bytes -= 4 * CHUNK_SIZE)
+    {
+        store_chunk(p, zero);
+        store_chunk(p + CHUNK_SIZE, zero);
+        store_chunk(p + (2 * CHUNK_SIZE), zero);
+        store_chunk(p + (3 * CHUNK_SIZE), zero);
+        p += 4 * CHUNK_SIZE;
+    }
+
+    for(; bytes >= CHUNK_SIZE; bytes -= CHUNK_SIZE)
+    {
+        store_chunk(p, zero);
+        p += CHUNK_SIZE;
+    }
+
+    for(uint64_t index = 0; index < bytes; index += 1)
+    {
+        p[index] = 0;
+    }
+}
+
+
+// Arena........................................................................
+
+#define ARENA_ALIGNMENT 16
+
+// Everything from used_end on has never been handed out, so it's still zeroed
+// from when the block was allocated.
+struct ArenaBlock
+{
+    ArenaBlock* prior;
+    uint8_t* top;
+    uint8_t* end;
+    uint8_t* used_end;
+    uint64_t bytes;
+};
+
+static uint64_t align_up(uint64_t x, uint64_t alignment)
+{
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+static uint8_t* get_block_start(ArenaBlock* block)
+{
+    return (uint8_t*) block + align_up(sizeof(ArenaBlock), ARENA_ALIGNMENT);
+}
+
+static void mark_used(ArenaBlock* block)
+{
+    if(block->top > block->used_end)
+    {
+        block->used_end = block->top;
+    }
+}
+
+static void* arena_allocate(Arena* arena, uint64_t bytes)
+{
+    uint64_t size = align_up(bytes, ARENA_ALIGNMENT);
+
+    ArenaBlock* block = arena->block;
+    if(!block || (uint64_t) (block->end - block->top) < size)
+    {
+        uint64_t header_size = align_up(sizeof(ArenaBlock), ARENA_ALIGNMENT);
+        uint64_t block_bytes = header_size + (size > arena->block_size ? size : arena->block_size);
+
+        ArenaBlock* new_block = allocate(arena->parent, block_bytes);
+        if(!new_block)
         {
-            p0 -= 1;
-            p1 -= 1;
-            *p1 = *p0;
+            return NULL;
         }
+        new_block->prior = block;
+        new_block->top = get_block_start(new_block);
+        new_block->used_end = new_block->top;
+        new_block->end = (uint8_t*) new_block + block_bytes;
+        new_block->bytes = block_bytes;
+        arena->block = new_block;
+        block = new_block;
     }
-    else
+
+    uint8_t* result = block->top;
+    block->top += size;
+    arena->last_allocation = result;
+
+    // Only memory handed out before, and given back by a reset or a free,
+    // needs zeroing again.
+    if(result < block->used_end)
     {
-        for(; bytes; bytes -= 1, p0 +=1, p1 += 1)
+        uint64_t dirty = (uint64_t) (block->used_end - result);
+        zero_memory(result, dirty < bytes ? dirty : bytes);
+    }
+    mark_used(block);
+
+    return result;
+}
+
+static void arena_deallocate(Arena* arena, void* memory, uint64_t bytes)
+{
+    (void) bytes;
+
+    if(memory && memory == arena->last_allocation)
+    {
+        arena->block->top = arena->last_allocation;
+        arena->last_allocation = NULL;
+    }
+}
+
+static void* arena_reallocate(Arena* arena, void* memory, uint64_t old_bytes, uint64_t new_bytes)
+{
+    if(memory && memory == arena->last_allocation)
+    {
+        ArenaBlock* block = arena->block;
+        uint8_t* new_top = arena->last_allocation + align_up(new_bytes, ARENA_ALIGNMENT);
+        if(new_top <= block->end)
         {
-            *p1 = *p0;
+            block->top = new_top;
+            if(new_bytes > old_bytes)
+            {
+                zero_memory((uint8_t*) memory + old_bytes, new_bytes - old_bytes);
+            }
+            mark_used(block);
+            return memory;
         }
     }
+
+    void* result = arena_allocate(arena, new_bytes);
+    if(result && memory)
+    {
+        copy_memory(result, memory, old_bytes < new_bytes ? old_bytes : new_bytes);
+    }
+    return result;
+}
+
+void arena_create(Allocator* allocator, Allocator* parent, uint64_t block_size)
+{
+    allocator->type = ALLOCATOR_TYPE_ARENA;
+    allocator->arena.parent = parent;
+    allocator->arena.block = NULL;
+    allocator->arena.last_allocation = NULL;
+    allocator->arena.block_size = block_size;
+}
+
+void arena_destroy(Allocator* allocator)
+{
+    ASSERT(allocator->type == ALLOCATOR_TYPE_ARENA);
+
+    Arena* arena = &allocator->arena;
+    ArenaBlock* block = arena->block;
+    while(block)
+    {
+        ArenaBlock* prior = block->prior;
+        deallocate(arena->parent, block, block->bytes);
+        block = prior;
+    }
+    arena->block = NULL;
+    arena->last_allocation = NULL;
+}
+
+// Frees everything allocated from the arena. If that took more than one
+// block, they all go back to the parent and the next block is made big enough
+// for the lot, so an arena that's reset regularly settles on a single block.
+void arena_reset(Allocator* allocator)
+{
+    ASSERT(allocator->type == ALLOCATOR_TYPE_ARENA);
+
+    Arena* arena = &allocator->arena;
+    ArenaBlock* block = arena->block;
+    if(!block)
+    {
+        return;
+    }
+
+    uint64_t used = 0;
+    ArenaBlock* prior = block->prior;
+    while(prior)
+    {
+        ArenaBlock* next = prior->prior;
+        used += prior->bytes;
+        deallocate(arena->parent, prior, prior->bytes);
+        prior = next;
+    }
+
+    block->prior = NULL;
+    block->top = get_block_start(block);
+    arena->last_allocation = NULL;
+
+    if(used > 0 && arena->block_size < block->bytes + used)
+    {
+        arena->block_size = block->bytes + used;
+        deallocate(arena->parent, block, block->bytes);
+        arena->block = NULL;
+    }
+}
+
+
+// Pool.........................................................................
+
+struct PoolSlot
+{
+    PoolSlot* next;
+};
+
+static void* pool_allocate(Pool* pool, uint64_t bytes)
+{
+    ASSERT(bytes <= pool->slot_size);
+
+    PoolSlot* slot = pool->free_slots;
+    if(!slot || bytes > pool->slot_size)
+    {
+        return NULL;
+    }
+    pool->free_slots = slot->next;
+
+    zero_memory(slot, bytes);
+
+    return slot;
+}
+
+static void pool_deallocate(Pool* pool, void* memory)
+{
+    if(memory)
+    {
+        uint8_t* p = memory;
+        ASSERT(p >= pool->slots && p < pool->slots + (pool->slot_size * pool->slots_count));
+
+        PoolSlot* slot = memory;
+        slot->next = pool->free_slots;
+        pool->free_slots = slot;
+    }
+}
+
+bool pool_create(Allocator* allocator, Allocator* parent, uint64_t object_size, int objects_count)
+{
+    uint64_t slot_size = align_up(object_size > sizeof(PoolSlot) ? object_size : sizeof(PoolSlot), ARENA_ALIGNMENT);
+
+    allocator->type = ALLOCATOR_TYPE_POOL;
+    Pool* pool = &allocator->pool;
+    pool->parent = parent;
+    pool->slot_size = slot_size;
+    pool->slots_count = objects_count;
+    pool->slots = allocate(parent, slot_size * objects_count);
+    pool->free_slots = NULL;
+
+    if(!pool->slots)
+    {
+        return false;
+    }
+
+    for(int index = objects_count - 1; index >= 0; index -= 1)
+    {
+        PoolSlot* slot = (PoolSlot*) (pool->slots + (slot_size * index));
+        slot->next = pool->free_slots;
+        pool->free_slots = slot;
+    }
+
+    return true;
+}
+
+void pool_destroy(Allocator* allocator)
+{
+    ASSERT(allocator->type == ALLOCATOR_TYPE_POOL);
+
+    Pool* pool = &allocator->pool;
+    deallocate(pool->parent, pool->slots, pool->slot_size * pool->slots_count);
+    pool->slots = NULL;
+    pool->free_slots = NULL;
+}
+
+
+// Tracker......................................................................
+
+static void lock_tracker(Tracker* tracker)
+{
+    while(!atomic_int_compare_exchange(&tracker->lock, 0, 1))
+    {
+        atomic_pause();
+    }
+}
+
+static void unlock_tracker(Tracker* tracker)
+{
+    atomic_int_store(&tracker->lock, 0);
+}
+
+static void track_change(Tracker* tracker, uint64_t freed, uint64_t allocated)
+{
+    lock_tracker(tracker);
+
+    tracker->bytes = tracker->bytes - freed + allocated;
+    if(tracker->bytes > tracker->peak_bytes)
+    {
+        tracker->peak_bytes = tracker->bytes;
+    }
+    if(freed)
+    {
+        tracker->deallocations_count += 1;
+    }
+    if(allocated)
+    {
+        tracker->allocations_count += 1;
+    }
+
+    unlock_tracker(tracker);
+}
+
+void tracker_create(Allocator* allocator, Allocator* parent)
+{
+    allocator->type = ALLOCATOR_TYPE_TRACKING;
+    Tracker* tracker = &allocator->tracker;
+    tracker->parent = parent;
+    tracker->allocations_count = 0;
+    tracker->bytes = 0;
+    tracker->deallocations_count = 0;
+    tracker->peak_bytes = 0;
+    atomic_int_store(&tracker->lock, 0);
+}
+
+void tracker_get_counts(Allocator* allocator, uint64_t* bytes, uint64_t* peak_bytes, uint64_t* allocations_count, uint64_t* deallocations_count)
+{
+    ASSERT(allocator->type == ALLOCATOR_TYPE_TRACKING);
+
+    Tracker* tracker = &allocator->tracker;
+    lock_tracker(tracker);
+    *bytes = tracker->bytes;
+    *peak_bytes = tracker->peak_bytes;
+    *allocations_count = tracker->allocations_count;
+    *deallocations_count = tracker->deallocations_count;
+    unlock_tracker(tracker);
+}
+
+
+// Dispatch.....................................................................
+
+void* allocate(Allocator* allocator, uint64_t bytes)
+{
+    if(!allocator)
+    {
+        return calloc(bytes, 1);
+    }
+
+    switch(allocator->type)
+    {
+        case ALLOCATOR_TYPE_ARENA:
+        {
+            return arena_allocate(&allocator->arena, bytes);
+        }
+        case ALLOCATOR_TYPE_POOL:
+        {
+            return pool_allocate(&allocator->pool, bytes);
+        }
+        case ALLOCATOR_TYPE_TRACKING:
+        {
+            void* result = allocate(allocator->tracker.parent, bytes);
+            if(result)
+            {
+                track_change(&allocator->tracker, 0, bytes);
+            }
+            return result;
+        }
+    }
+
+    return NULL;
 }
 
 void deallocate(Allocator* allocator, void* memory, uint64_t bytes)
 {
-    free(memory);
+    if(!allocator)
+    {
+        free(memory);
+        return;
+    }
+
+    switch(allocator->type)
+    {
+        case ALLOCATOR_TYPE_ARENA:
+        {
+            arena_deallocate(&allocator->arena, memory, bytes);
+            break;
+        }
+        case ALLOCATOR_TYPE_POOL:
+        {
+            pool_deallocate(&allocator->pool, memory);
+            break;
+        }
+        case ALLOCATOR_TYPE_TRACKING:
+        {
+            if(memory)
+            {
+                deallocate(allocator->tracker.parent, memory, bytes);
+                track_change(&allocator->tracker, bytes, 0);
+            }
+            break;
+        }
+    }
+}
+
+// Any bytes past old_bytes are zeroed, to match allocate.
+void* reallocate(Allocator* allocator, void* memory, uint64_t old_bytes, uint64_t new_bytes)
+{
+    if(!allocator)
+    {
+        uint8_t* result = realloc(memory, new_bytes);
+        if(result && new_bytes > old_bytes)
+        {
+            zero_memory(result + old_bytes, new_bytes - old_bytes);
+        }
+        return result;
+    }
+
+    switch(allocator->type)
+    {
+        case ALLOCATOR_TYPE_ARENA:
+        {
+            return arena_reallocate(&allocator->arena, memory, old_bytes, new_bytes);
+        }
+        case ALLOCATOR_TYPE_POOL:
+        {
+            if(new_bytes <= allocator->pool.slot_size)
+            {
+                if(!memory)
+                {
+                    return pool_allocate(&allocator->pool, new_bytes);
+                }
+                if(new_bytes > old_bytes)
+                {
+                    zero_memory((uint8_t*) memory + old_bytes, new_bytes - old_bytes);
+                }
+                return memory;
+            }
+            return NULL;
+        }
+        case ALLOCATOR_TYPE_TRACKING:
+        {
+            void* result = reallocate(allocator->tracker.parent, memory, old_bytes, new_bytes);
+            if(result)
+            {
+                track_change(&allocator->tracker, memory ? old_bytes : 0, new_bytes);
+            }
+            return result;
+        }
+    }
+
+    return NULL;
 }
 
-void zero_memory(void* memory, uint64_t bytes)
+// The block taken from the allocator has room to move the start up to the
+// boundary, with the block's own address stored just before it.
+void* allocate_aligned(Allocator* allocator, uint64_t bytes, uint64_t alignment)
+{
+    ASSERT(alignment >= sizeof(void*) && (alignment & (alignment - 1)) == 0);
+
+    uint8_t* block = allocate(allocator, bytes + alignment + sizeof(void*));
+    if(!block)
+    {
+        return NULL;
+    }
+
+    uintptr_t address = (uintptr_t) (block + sizeof(void*));
+    address = (address + alignment - 1) & ~((uintptr_t) alignment - 1);
+
+    void** result = (void**) address;
+    result[-1] = block;
+    return result;
+}
+
+void deallocate_aligned(Allocator* allocator, void* memory, uint64_t bytes, uint64_t alignment)
 {
-    for(uint8_t* p = memory; bytes; bytes -= 1, p += 1)
+    if(!memory)
     {
-        *p = 0;
+        return;
     }
+
+    void* block = ((void**) memory)[-1];
+    deallocate(allocator, block, bytes + alignment + sizeof(void*));
 }
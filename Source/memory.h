@@ -1,13 +1,101 @@
 #ifndef MEMORY_H_
 #define MEMORY_H_
 
+#include "atomic.h"
+
+#include <stdbool.h>
 #include <stdint.h>
 
+// Passing a null allocator anywhere one is taken means the C heap. Memory
+// handed out by any allocator is zeroed, and aligned to 16 bytes.
+//
+// An arena hands out memory from large blocks, bumping a pointer along. Freeing
+// only gives memory back if it was the most recent allocation, but the whole
+// arena can be reset at once. It's for scratch memory with a clear lifetime,
+// like the memory used while rendering one tile. When a block runs out a new
+// one is taken from the parent allocator.
+//
+// A pool hands out objects of one fixed size from a fixed number of slots,
+// reusing freed slots first.
+//
+// A tracking allocator passes everything through to its parent, while counting
+// allocations and the bytes in use, including the peak. Unlike the others, it
+// can be shared between threads.
+//
+// Arenas and pools must only be used by one thread at a time.
+//
+// Memory from allocate_aligned starts on a boundary wider than 16 bytes, such
+// as a cache line. It takes a little more from the allocator to get there, and
+// has to be given back with deallocate_aligned using the same alignment.
+
+#define CACHE_LINE_SIZE 64
+
 typedef struct Allocator Allocator;
 
+typedef enum AllocatorType
+{
+    ALLOCATOR_TYPE_ARENA,
+    ALLOCATOR_TYPE_POOL,
+    ALLOCATOR_TYPE_TRACKING,
+} AllocatorType;
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct PoolSlot PoolSlot;
+
+typedef struct Arena
+{
+    Allocator* parent;
+    ArenaBlock* block;
+    uint8_t* last_allocation;
+    uint64_t block_size;
+} Arena;
+
+typedef struct Pool
+{
+    Allocator* parent;
+    PoolSlot* free_slots;
+    uint8_t* slots;
+    uint64_t slot_size;
+    int slots_count;
+} Pool;
+
+typedef struct Tracker
+{
+    Allocator* parent;
+    AtomicInt lock;
+    uint64_t allocations_count;
+    uint64_t bytes;
+    uint64_t deallocations_count;
+    uint64_t peak_bytes;
+} Tracker;
+
+struct Allocator
+{
+    union
+    {
+        Arena arena;
+        Pool pool;
+        Tracker tracker;
+    };
+    AllocatorType type;
+};
+
 void* allocate(Allocator* allocator, uint64_t bytes);
+void* allocate_aligned(Allocator* allocator, uint64_t bytes, uint64_t alignment);
 void copy_memory(void* to, const void* from, uint64_t bytes);
 void deallocate(Allocator* allocator, void* memory, uint64_t bytes);
+void deallocate_aligned(Allocator* allocator, void* memory, uint64_t bytes, uint64_t alignment);
+void* reallocate(Allocator* allocator, void* memory, uint64_t old_bytes, uint64_t new_bytes);
 void zero_memory(void* memory, uint64_t bytes);
 
+void arena_create(Allocator* allocator, Allocator* parent, uint64_t block_size);
+void arena_destroy(Allocator* allocator);
+void arena_reset(Allocator* allocator);
+
+bool pool_create(Allocator* allocator, Allocator* parent, uint64_t object_size, int objects_count);
+void pool_destroy(Allocator* allocator);
+
+void tracker_create(Allocator* allocator, Allocator* parent);
+void tracker_get_counts(Allocator* allocator, uint64_t* bytes, uint64_t* peak_bytes, uint64_t* allocations_count, uint64_t* deallocations_count);
+
 #endif // MEMORY_H_
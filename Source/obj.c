@@ -0,0 +1,239 @@
+#include "obj.h"
+
+#include "filesystem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct VertexArray
+{
+    Float3* vertices;
+    int cap;
+    int count;
+} VertexArray;
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skip_spaces(const char* at)
+{
+    while(is_space(*at))
+    {
+        at += 1;
+    }
+    return at;
+}
+
+static const char* skip_line(const char* at)
+{
+    while(*at && *at != '\n')
+    {
+        at += 1;
+    }
+    return at;
+}
+
+static bool grow(Allocator* allocator, void** array, int* cap, int needed, uint64_t element_size)
+{
+    if(needed <= *cap)
+    {
+        return true;
+    }
+
+    int new_cap = *cap > 0 ? *cap : 64;
+    while(new_cap < needed)
+    {
+        new_cap *= 2;
+    }
+
+    void* result = reallocate(allocator, *array, element_size * *cap, element_size * new_cap);
+    if(!result)
+    {
+        return false;
+    }
+
+    *array = result;
+    *cap = new_cap;
+
+    return true;
+}
+
+// Reads one corner of a face, which can be "v", "v/t", "v//n" or "v/t/n".
+// Only the vertex is kept. Negative indices count back from the most recent
+// vertex.
+static const char* parse_corner(const char* at, int vertices_count, int* vertex_index)
+{
+    char* end;
+    long index = strtol(at, &end, 10);
+    if(end == at || index == 0)
+    {
+        return NULL;
+    }
+
+    if(index < 0)
+    {
+        index += vertices_count;
+    }
+    else
+    {
+        index -= 1;
+    }
+
+    if(index < 0 || index >= vertices_count)
+    {
+        return NULL;
+    }
+
+    *vertex_index = (int) index;
+
+    at = end;
+    while(*at && !is_space(*at) && *at != '\n')
+    {
+        at += 1;
+    }
+
+    return at;
+}
+
+static bool add_triangle(ObjMesh* mesh, Float3 a, Float3 b, Float3 c)
+{
+    bool grown = grow(mesh->allocator, (void**) &mesh->triangles, &mesh->triangles_cap, mesh->triangles_count + 1, sizeof(Triangle));
+    if(!grown)
+    {
+        return false;
+    }
+
+    Triangle* triangle = &mesh->triangles[mesh->triangles_count];
+    triangle->vertices[0] = a;
+    triangle->vertices[1] = b;
+    triangle->vertices[2] = c;
+    mesh->triangles_count += 1;
+
+    return true;
+}
+
+static bool parse(ObjMesh* mesh, VertexArray* vertices, const char* at, const char* path)
+{
+    for(int line = 1; *at; line += 1)
+    {
+        at = skip_spaces(at);
+
+        if(at[0] == 'v' && is_space(at[1]))
+        {
+            Float3 vertex;
+            at += 1;
+            for(int axis = 0; axis < 3; axis += 1)
+            {
+                char* end;
+                vertex.e[axis] = strtof(at, &end);
+                if(end == at)
+                {
+                    fprintf(stderr, "%s:%i: Expected three numbers for a vertex.\n", path, line);
+                    return false;
+                }
+                at = end;
+            }
+
+            bool grown = grow(mesh->allocator, (void**) &vertices->vertices, &vertices->cap, vertices->count + 1, sizeof(Float3));
+            if(!grown)
+            {
+                return false;
+            }
+            vertices->vertices[vertices->count] = vertex;
+            vertices->count += 1;
+        }
+        else if(at[0] == 'f' && is_space(at[1]))
+        {
+            at = skip_spaces(at + 1);
+
+            int corners[3];
+            int corners_count = 0;
+
+            while(*at && *at != '\n')
+            {
+                int vertex_index;
+                at = parse_corner(at, vertices->count, &vertex_index);
+                if(!at)
+                {
+                    fprintf(stderr, "%s:%i: A face refers to a vertex that doesn't exist.\n", path, line);
+                    return false;
+                }
+
+                if(corners_count < 3)
+                {
+                    corners[corners_count] = vertex_index;
+                    corners_count += 1;
+                }
+                else
+                {
+                    corners[1] = corners[2];
+                    corners[2] = vertex_index;
+                }
+
+                if(corners_count == 3)
+                {
+                    Float3* v = vertices->vertices;
+                    if(!add_triangle(mesh, v[corners[0]], v[corners[1]], v[corners[2]]))
+                    {
+                        return false;
+                    }
+                }
+
+                at = skip_spaces(at);
+            }
+
+            if(corners_count < 3)
+            {
+                fprintf(stderr, "%s:%i: A face needs at least three corners.\n", path, line);
+                return false;
+            }
+        }
+
+        at = skip_line(at);
+        if(*at == '\n')
+        {
+            at += 1;
+        }
+    }
+
+    return true;
+}
+
+bool obj_load_file(ObjMesh* mesh, const char* path, Allocator* allocator)
+{
+    mesh->allocator = allocator;
+    mesh->triangles = NULL;
+    mesh->triangles_cap = 0;
+    mesh->triangles_count = 0;
+
+    char* contents;
+    uint64_t bytes;
+    if(!load_whole_file(path, &contents, &bytes, allocator))
+    {
+        fprintf(stderr, "Couldn't read the mesh %s.\n", path);
+        return false;
+    }
+
+    VertexArray vertices = {0};
+    bool parsed = parse(mesh, &vertices, contents, path);
+
+    deallocate(allocator, vertices.vertices, sizeof(Float3) * vertices.cap);
+    deallocate(allocator, contents, bytes + 1);
+
+    if(!parsed)
+    {
+        obj_destroy(mesh);
+    }
+
+    return parsed;
+}
+
+void obj_destroy(ObjMesh* mesh)
+{
+    deallocate(mesh->allocator, mesh->triangles, sizeof(Triangle) * mesh->triangles_cap);
+    mesh->triangles = NULL;
+    mesh->triangles_cap = 0;
+    mesh->triangles_count = 0;
+}
@@ -0,0 +1,26 @@
+// Wavefront Object File Format (.obj)
+//
+// Only geometry is read: vertex positions and the faces between them. Faces
+// with more than three corners are split into a fan of triangles. Texture
+// coordinates, normals, groups and materials are skipped.
+
+#ifndef OBJ_H_
+#define OBJ_H_
+
+#include "memory.h"
+#include "world.h"
+
+#include <stdbool.h>
+
+typedef struct ObjMesh
+{
+    Allocator* allocator;
+    Triangle* triangles;
+    int triangles_cap;
+    int triangles_count;
+} ObjMesh;
+
+bool obj_load_file(ObjMesh* mesh, const char* path, Allocator* allocator);
+void obj_destroy(ObjMesh* mesh);
+
+#endif // OBJ_H_
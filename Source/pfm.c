@@ -0,0 +1,43 @@
+#include "pfm.h"
+
+#include "filesystem.h"
+
+#include <stdio.h>
+
+// Only one row is held in memory at a time, so writing doesn't need a second
+// copy of the whole image.
+bool pfm_write_file(const char* path, int width, int height, PfmRowCall fill_row, void* data, Allocator* allocator)
+{
+    // A negative scale marks the floats as little-endian.
+    uint16_t endian_test = 1;
+    bool little_endian = *(uint8_t*) &endian_test == 1;
+
+    char header[64];
+    int header_size = snprintf(header, sizeof(header), "PF\n%i %i\n%s\n", width, height, little_endian ? "-1.0" : "1.0");
+
+    uint64_t row_size = sizeof(float) * 3 * width;
+    float* row = allocate(allocator, row_size);
+    if(!row)
+    {
+        return false;
+    }
+
+    FileWriter writer;
+    if(!file_writer_open(&writer, path))
+    {
+        deallocate(allocator, row, row_size);
+        return false;
+    }
+
+    file_writer_write(&writer, header, header_size);
+
+    for(int y = 0; y < height; y += 1)
+    {
+        fill_row(data, y, row);
+        file_writer_write(&writer, row, row_size);
+    }
+
+    deallocate(allocator, row, row_size);
+
+    return file_writer_close(&writer);
+}
@@ -0,0 +1,18 @@
+// Portable Float Map File Format (.pfm)
+//
+// Three 32-bit floats per pixel, so linear radiance is kept without clamping
+// or quantising it. Rows run from the bottom of the image to the top.
+
+#ifndef PFM_H_
+#define PFM_H_
+
+#include "memory.h"
+
+#include <stdbool.h>
+
+// Fills row y of the image with width red, green and blue triples.
+typedef void (*PfmRowCall)(void* data, int y, float* row);
+
+bool pfm_write_file(const char* path, int width, int height, PfmRowCall fill_row, void* data, Allocator* allocator);
+
+#endif // PFM_H_
@@ -0,0 +1,283 @@
+#include "profile.h"
+
+#include "atomic.h"
+#include "filesystem.h"
+
+#include <float.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(PROFILE_ENABLED)
+
+THREAD_LOCAL ProfileThread* profile_current_thread;
+
+static ProfileThread profile_threads[PROFILE_THREADS_CAP];
+static AtomicInt profile_threads_count;
+
+static const char* counter_names[PROFILE_COUNTER_COUNT] =
+{
+    "rays",
+    "shadow rays",
+    "BVH nodes",
+    "triangle tests",
+    "sphere tests",
+    "plane tests",
+    "tasks",
+    "lock wait ns",
+    "idle ns",
+};
+
+static int get_threads_count(void)
+{
+    long count = atomic_int_load(&profile_threads_count);
+    return count < PROFILE_THREADS_CAP ? (int) count : PROFILE_THREADS_CAP;
+}
+
+bool profile_is_enabled(void)
+{
+    return true;
+}
+
+// Threads past the cap go uncounted.
+void profile_thread_start(const char* label)
+{
+    long index = atomic_int_add(&profile_threads_count, 1) - 1;
+    if(index >= PROFILE_THREADS_CAP)
+    {
+        return;
+    }
+
+    ProfileThread* thread = &profile_threads[index];
+    thread->label = label;
+    profile_current_thread = thread;
+}
+
+void profile_path_depth(int depth)
+{
+    ProfileThread* thread = profile_current_thread;
+    if(!thread)
+    {
+        return;
+    }
+
+    if(depth >= PROFILE_DEPTH_BUCKETS)
+    {
+        depth = PROFILE_DEPTH_BUCKETS - 1;
+    }
+    thread->depth_histogram[depth] += 1;
+}
+
+void profile_add_event(const char* label, double start, double end)
+{
+    ProfileThread* thread = profile_current_thread;
+    if(!thread)
+    {
+        return;
+    }
+
+    if(thread->events_count == thread->events_cap)
+    {
+        int cap = thread->events_cap > 0 ? 2 * thread->events_cap : 1024;
+        ProfileEvent* events = reallocate(NULL, thread->events, sizeof(ProfileEvent) * thread->events_cap, sizeof(ProfileEvent) * cap);
+        if(!events)
+        {
+            return;
+        }
+        thread->events = events;
+        thread->events_cap = cap;
+    }
+
+    ProfileEvent* event = &thread->events[thread->events_count];
+    event->label = label;
+    event->start = start;
+    event->end = end;
+    thread->events_count += 1;
+}
+
+void profile_print_counters(FILE* file)
+{
+    int threads_count = get_threads_count();
+
+    uint64_t totals[PROFILE_COUNTER_COUNT] = {0};
+    uint64_t depth_histogram[PROFILE_DEPTH_BUCKETS] = {0};
+
+    for(int thread_index = 0; thread_index < threads_count; thread_index += 1)
+    {
+        ProfileThread* thread = &profile_threads[thread_index];
+
+        fprintf(file, "Thread %i (%s):", thread_index, thread->label);
+        for(int counter = 0; counter < PROFILE_COUNTER_COUNT; counter += 1)
+        {
+            fprintf(file, " %s %llu%s", counter_names[counter], (unsigned long long) thread->counts[counter],
+                counter + 1 < PROFILE_COUNTER_COUNT ? "," : "\n");
+            totals[counter] += thread->counts[counter];
+        }
+
+        for(int bucket = 0; bucket < PROFILE_DEPTH_BUCKETS; bucket += 1)
+        {
+            depth_histogram[bucket] += thread->depth_histogram[bucket];
+        }
+    }
+
+    uint64_t rays = totals[PROFILE_COUNTER_RAYS] + totals[PROFILE_COUNTER_SHADOW_RAYS];
+    if(rays > 0)
+    {
+        uint64_t primitive_tests = totals[PROFILE_COUNTER_TRIANGLE_TESTS] + totals[PROFILE_COUNTER_SPHERE_TESTS] + totals[PROFILE_COUNTER_PLANE_TESTS];
+        fprintf(file, "Per ray: %.2f BVH nodes, %.2f primitive tests.\n",
+            totals[PROFILE_COUNTER_BVH_NODES] / (double) rays, primitive_tests / (double) rays);
+    }
+
+    fprintf(file, "Path depth histogram:");
+    for(int bucket = 0; bucket < PROFILE_DEPTH_BUCKETS - 1; bucket += 1)
+    {
+        if(depth_histogram[bucket] > 0)
+        {
+            fprintf(file, " %i:%llu", bucket, (unsigned long long) depth_histogram[bucket]);
+        }
+    }
+    fprintf(file, " %i+:%llu\n", PROFILE_DEPTH_BUCKETS - 1, (unsigned long long) depth_histogram[PROFILE_DEPTH_BUCKETS - 1]);
+}
+
+// Events are written as complete events, with times in microseconds from
+// the earliest event, and each thread is named with a metadata event.
+static void write_text(FileWriter* writer, const char* text, int length, int cap)
+{
+    // snprintf returns the length the text would have had, so don't trust it
+    // past the end of the buffer.
+    if(length < 0)
+    {
+        return;
+    }
+    if(length > cap - 1)
+    {
+        length = cap - 1;
+    }
+    file_writer_write(writer, text, length);
+}
+
+static void write_json_string(FileWriter* writer, const char* text)
+{
+    const char* run = text;
+    for(const char* c = text; *c; c += 1)
+    {
+        if(*c == '"' || *c == '\\' || (unsigned char) *c < 0x20)
+        {
+            file_writer_write(writer, run, c - run);
+            char escape[7];
+            int length = snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char) *c);
+            write_text(writer, escape, length, sizeof(escape));
+            run = c + 1;
+        }
+    }
+    file_writer_write(writer, run, strlen(run));
+}
+
+bool profile_write_trace(const char* path)
+{
+    int threads_count = get_threads_count();
+
+    double epoch = DBL_MAX;
+    for(int thread_index = 0; thread_index < threads_count; thread_index += 1)
+    {
+        ProfileThread* thread = &profile_threads[thread_index];
+        if(thread->events_count > 0 && thread->events[0].start < epoch)
+        {
+            epoch = thread->events[0].start;
+        }
+    }
+
+    FileWriter writer;
+    if(!file_writer_open(&writer, path))
+    {
+        return false;
+    }
+
+    char line[128];
+    bool first = true;
+
+    file_writer_write(&writer, "{\"traceEvents\":[\n", 17);
+
+    for(int thread_index = 0; thread_index < threads_count; thread_index += 1)
+    {
+        ProfileThread* thread = &profile_threads[thread_index];
+
+        int length = snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"",
+            first ? "" : ",\n", thread_index);
+        write_text(&writer, line, length, sizeof(line));
+        write_json_string(&writer, thread->label);
+        length = snprintf(line, sizeof(line), " %i\"}}", thread_index);
+        write_text(&writer, line, length, sizeof(line));
+        first = false;
+
+        for(int event_index = 0; event_index < thread->events_count; event_index += 1)
+        {
+            ProfileEvent* event = &thread->events[event_index];
+            double start = 1e6 * (event->start - epoch);
+            double duration = 1e6 * (event->end - event->start);
+            file_writer_write(&writer, ",\n{\"name\":\"", 11);
+            write_json_string(&writer, event->label);
+            length = snprintf(line, sizeof(line), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}",
+                thread_index, start, duration);
+            write_text(&writer, line, length, sizeof(line));
+        }
+    }
+
+    file_writer_write(&writer, "\n]}\n", 4);
+
+    return file_writer_close(&writer);
+}
+
+void profile_destroy(void)
+{
+    int threads_count = get_threads_count();
+
+    for(int thread_index = 0; thread_index < threads_count; thread_index += 1)
+    {
+        ProfileThread* thread = &profile_threads[thread_index];
+        deallocate(NULL, thread->events, sizeof(ProfileEvent) * thread->events_cap);
+        zero_memory(thread, sizeof(ProfileThread));
+    }
+
+    atomic_int_store(&profile_threads_count, 0);
+}
+
+#else
+
+bool profile_is_enabled(void)
+{
+    return false;
+}
+
+void profile_thread_start(const char* label)
+{
+    (void) label;
+}
+
+void profile_path_depth(int depth)
+{
+    (void) depth;
+}
+
+void profile_add_event(const char* label, double start, double end)
+{
+    (void) label;
+    (void) start;
+    (void) end;
+}
+
+void profile_print_counters(FILE* file)
+{
+    (void) file;
+}
+
+bool profile_write_trace(const char* path)
+{
+    (void) path;
+    return false;
+}
+
+void profile_destroy(void)
+{
+}
+
+#endif // defined(PROFILE_ENABLED)
@@ -0,0 +1,116 @@
+// Profiling
+//
+// Counts where the work goes on each thread and records a timeline of the
+// tasks and tiles each thread ran, which can be written out as a Chrome trace
+// and opened in chrome://tracing or Perfetto.
+//
+// It's only compiled in when PROFILE_ENABLED is defined, which the PROFILE
+// build option does. Otherwise the macros used on the hot paths expand to
+// nothing, and the functions here do nothing.
+//
+// A thread has to call PROFILE_THREAD_START before anything it does is
+// counted. Each thread's counts are only touched by that thread, so reading
+// them is only safe once every thread being profiled has stopped working.
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include "thread_pool.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_DEPTH_BUCKETS 32
+#define PROFILE_THREADS_CAP 256
+
+typedef enum ProfileCounter
+{
+    PROFILE_COUNTER_RAYS,
+    PROFILE_COUNTER_SHADOW_RAYS,
+    PROFILE_COUNTER_BVH_NODES,
+    PROFILE_COUNTER_TRIANGLE_TESTS,
+    PROFILE_COUNTER_SPHERE_TESTS,
+    PROFILE_COUNTER_PLANE_TESTS,
+    PROFILE_COUNTER_TASKS,
+    PROFILE_COUNTER_LOCK_WAIT_NANOSECONDS,
+    PROFILE_COUNTER_IDLE_NANOSECONDS,
+    PROFILE_COUNTER_COUNT,
+} ProfileCounter;
+
+#if defined(PROFILE_ENABLED)
+
+#define PROFILE_THREAD_START(label) \
+    profile_thread_start(label)
+
+// Counting goes straight to the thread's own counts, without a call, since
+// some counts are made for every node of the hierarchy a ray visits.
+#define PROFILE_COUNT(counter, amount) \
+    do \
+    { \
+        ProfileThread* profile_thread = profile_current_thread; \
+        if(profile_thread) \
+        { \
+            profile_thread->counts[counter] += (amount); \
+        } \
+    } while(0)
+
+#define PROFILE_PATH_DEPTH(depth) \
+    profile_path_depth(depth)
+
+#define PROFILE_START(name) \
+    double profile_start_##name = get_time_seconds()
+
+#define PROFILE_STOP_TIME(name, counter) \
+    PROFILE_COUNT(counter, (uint64_t) (1e9 * (get_time_seconds() - profile_start_##name)))
+
+#define PROFILE_STOP_EVENT(name, label) \
+    profile_add_event(label, profile_start_##name, get_time_seconds())
+
+#else
+
+#define PROFILE_THREAD_START(label)
+#define PROFILE_COUNT(counter, amount)
+#define PROFILE_PATH_DEPTH(depth)
+#define PROFILE_START(name)
+#define PROFILE_STOP_TIME(name, counter)
+#define PROFILE_STOP_EVENT(name, label)
+
+#endif // defined(PROFILE_ENABLED)
+
+// An interval on one thread's timeline. The label should be a string literal,
+// since only the pointer is kept.
+typedef struct ProfileEvent
+{
+    const char* label;
+    double start;
+    double end;
+} ProfileEvent;
+
+typedef struct ProfileThread
+{
+    uint64_t counts[PROFILE_COUNTER_COUNT];
+    uint64_t depth_histogram[PROFILE_DEPTH_BUCKETS];
+    ProfileEvent* events;
+    const char* label;
+    int events_cap;
+    int events_count;
+
+    // Keeps the counts of threads in neighbouring slots off each other's
+    // cache lines.
+    uint8_t padding[64];
+} ProfileThread;
+
+#if defined(PROFILE_ENABLED)
+extern THREAD_LOCAL ProfileThread* profile_current_thread;
+#endif
+
+bool profile_is_enabled(void);
+void profile_thread_start(const char* label);
+void profile_path_depth(int depth);
+void profile_add_event(const char* label, double start, double end);
+void profile_print_counters(FILE* file);
+bool profile_write_trace(const char* path);
+void profile_destroy(void);
+
+#endif // PROFILE_H_
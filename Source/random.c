@@ -101,6 +101,29 @@ uint64_t random_generate(RandomGenerator* generator)
     return result;
 }
 
+void random_jump(RandomGenerator* generator)
+{
+    static const uint64_t jump[] = {UINT64_C(0xbeac0467eba5facb), UINT64_C(0xd86b048b86aa9922)};
+
+    uint64_t s0 = 0;
+    uint64_t s1 = 0;
+    for(int i = 0; i < 2; i += 1)
+    {
+        for(int b = 0; b < 64; b += 1)
+        {
+            if(jump[i] & UINT64_C(1) << b)
+            {
+                s0 ^= generator->s[0];
+                s1 ^= generator->s[1];
+            }
+            random_generate(generator);
+        }
+    }
+
+    generator->s[0] = s0;
+    generator->s[1] = s1;
+}
+
 // End of Blackman & Vigna's code
 
 static uint64_t random_uint64_range(RandomGenerator* generator, uint64_t range)
@@ -158,6 +181,20 @@ uint64_t random_seed_by_time(RandomGenerator* generator)
     return random_seed(generator, (uint64_t) time(NULL));
 }
 
+// Seeds a generator for one sample of one pixel from a hash of the indices,
+// so that the sample comes out the same no matter which thread takes it or in
+// what order.
+void random_seed_sample(RandomGenerator* generator, uint64_t frame_seed, uint64_t pixel_index, uint64_t sample_index)
+{
+    uint64_t x = frame_seed;
+    uint64_t hash = splitmix64(&x);
+    x = hash ^ pixel_index;
+    hash = splitmix64(&x);
+    x = hash ^ sample_index;
+    hash = splitmix64(&x);
+    random_seed(generator, hash);
+}
+
 void shuffle(RandomGenerator* generator, int* numbers, int count)
 {
     for(int i = 0; i < count - 2; i += 1)
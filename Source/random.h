@@ -14,6 +14,8 @@ uint64_t random_generate(RandomGenerator* generator);
 int random_int_range(RandomGenerator* generator, int min, int max);
 uint64_t random_seed(RandomGenerator* generator, uint64_t value);
 uint64_t random_seed_by_time(RandomGenerator* generator);
+void random_seed_sample(RandomGenerator* generator, uint64_t frame_seed, uint64_t pixel_index, uint64_t sample_index);
+void random_jump(RandomGenerator* generator);
 void shuffle(RandomGenerator* generator, int* numbers, int count);
 
 #endif // RANDOM_H_
@@ -0,0 +1,770 @@
+#include "render_internal.h"
+
+#include "assert.h"
+#include "bsdf.h"
+#include "light.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stddef.h>
+
+typedef union Pack4x8
+{
+    struct
+    {
+        uint8_t b, g, r, a;
+    };
+    uint32_t packed;
+} Pack4x8;
+
+void image_destroy(Image* image)
+{
+    deallocate(image->allocator, image->pixels, sizeof(PixelU32) * image->dimensions.x * image->dimensions.y);
+}
+
+static uint32_t pack_unorm3x8(Float3 v)
+{
+    Pack4x8 u;
+    u.r = (uint8_t) (0xff * v.x);
+    u.g = (uint8_t) (0xff * v.y);
+    u.b = (uint8_t) (0xff * v.z);
+    u.a = 0xff;
+    return u.packed;
+}
+
+static bool is_unorm(float x)
+{
+    return x >= 0.0f && x <= 1.0f;
+}
+
+uint32_t rgb_to_uint32(Float3 c)
+{
+    ASSERT(is_unorm(c.x));
+    ASSERT(is_unorm(c.y));
+    ASSERT(is_unorm(c.z));
+    return pack_unorm3x8(c);
+}
+
+static float linear_to_srgb_component(float x)
+{
+    if(x <= 0.0031308f)
+    {
+        return x * 12.92f;
+    }
+    else
+    {
+        return 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+    }
+}
+
+static Float3 linear_to_srgb(Float3 colour)
+{
+    Float3 result;
+    result.x = linear_to_srgb_component(colour.x);
+    result.y = linear_to_srgb_component(colour.y);
+    result.z = linear_to_srgb_component(colour.z);
+    return result;
+}
+
+static Float3 float3_clamp_unorm(Float3 v)
+{
+    Float3 result;
+    result.x = fmaxf(fminf(v.x, 1.0f), 0.0f);
+    result.y = fmaxf(fminf(v.y, 1.0f), 0.0f);
+    result.z = fmaxf(fminf(v.z, 1.0f), 0.0f);
+    return result;
+}
+
+Film film_create(Camera* camera, Int2 dimensions)
+{
+    Matrix4 view = matrix4_look_at(camera->position, camera->target, float3_unit_z);
+
+    Film film;
+    film.inverse_view = matrix4_inverse_view(view);
+    film.position = camera->position;
+    film.dimensions = dimensions;
+
+    float aspect_ratio = dimensions.x / (float) dimensions.y;
+    film.scale_y = tanf(0.5f * camera->field_of_view);
+    film.scale_x = aspect_ratio * film.scale_y;
+
+    film.half_pixel_width = film.scale_x * 0.5f / dimensions.x;
+    film.half_pixel_height = film.scale_y * 0.5f / dimensions.y;
+
+    return film;
+}
+
+Ray film_generate_ray(const Film* film, int x, int y, Sampler* sampler)
+{
+    float film_x = 2.0f * ((x + 0.5f) / film->dimensions.x) - 1.0f;
+    float film_y = 2.0f * ((y + 0.5f) / film->dimensions.y) - 1.0f;
+
+    Float3 film_point = {film_x * film->scale_x, film_y * film->scale_y, -1.0f};
+
+    Float2 u = sampler_next_2d(sampler);
+
+    Float3 jitter;
+    jitter.x = film->half_pixel_width * ((2.0f * u.x) - 1.0f);
+    jitter.y = film->half_pixel_height * ((2.0f * u.y) - 1.0f);
+    jitter.z = 0.0f;
+
+    Float3 jittered_point = float3_add(film_point, jitter);
+    Float3 ray_point = matrix4_transform_point(film->inverse_view, jittered_point);
+
+    Ray ray;
+    ray.origin = film->position;
+    ray.direction = float3_normalise(float3_subtract(ray_point, ray.origin));
+
+    return ray;
+}
+
+void image_store_pixel(Image* image, int x, int y, Float3 colour)
+{
+    colour = float3_clamp_unorm(colour);
+    Float3 srgb_colour = linear_to_srgb(colour);
+    uint32_t pixel_value = rgb_to_uint32(srgb_colour);
+
+    image->pixels[(image->dimensions.x * y) + x].value = pixel_value;
+}
+
+// Moves the ray to the hit point and points it in the direction of the next
+// bounce, sampled from the material's BSDF. The weight is the factor that
+// light arriving back along the new ray is scaled by on its way out along the
+// old one, and pdf is the chance of sampling the new direction. Returns false
+// if the path can't continue.
+bool scatter(Ray* ray, Hit hit, Material material, Sampler* sampler, Float3* weight, float* pdf)
+{
+    Float3 outgoing = float3_negate(ray->direction);
+    float lobe_sample = sampler_next_1d(sampler);
+    Float2 direction_sample = sampler_next_2d(sampler);
+
+    BsdfSample sample = bsdf_sample(material, hit.normal, outgoing, lobe_sample, direction_sample);
+    if(!sample.valid)
+    {
+        return false;
+    }
+
+    ray->origin = float3_add(float3_multiply(hit.distance, ray->direction), ray->origin);
+    ray->direction = sample.incoming;
+    *weight = sample.weight;
+    *pdf = sample.pdf;
+
+    return true;
+}
+
+static float power_heuristic(float pdf, float other_pdf)
+{
+    float squared = pdf * pdf;
+    float other_squared = other_pdf * other_pdf;
+    return squared / (squared + other_squared);
+}
+
+// Samples one light with a shadow ray. The result is weighted against the
+// chance that sampling the BSDF would have found the same light, since paths
+// also pick up emission when they hit a light by bouncing.
+Float3 estimate_direct_light(const Tile* tile, Float3 point, Float3 normal, Float3 outgoing, Material material, Sampler* sampler)
+{
+    World* world = tile->world;
+    float select_sample = sampler_next_1d(sampler);
+    Float2 position_sample = sampler_next_2d(sampler);
+
+    LightSample light = light_sample(world, point, select_sample, position_sample);
+    if(!light.valid || light.pdf <= 0.0f)
+    {
+        return float3_zero;
+    }
+
+    float cos_incoming = float3_dot(light.incoming, normal);
+    if(cos_incoming <= 0.0f)
+    {
+        return float3_zero;
+    }
+
+    Ray shadow_ray = {point, light.incoming};
+    tile->counters->shadow_rays += 1;
+    if(occluded(shadow_ray, light.distance * 0.999f, world))
+    {
+        return float3_zero;
+    }
+
+    Float3 f = bsdf_evaluate(material, normal, outgoing, light.incoming);
+    float bsdf_probability = bsdf_pdf(material, normal, outgoing, light.incoming);
+    float weight = power_heuristic(light.pdf, bsdf_probability);
+
+    Float3 radiance = float3_pointwise_multiply(f, light.radiance);
+    return float3_multiply(cos_incoming * weight / light.pdf, radiance);
+}
+
+// The share of emission found by BSDF sampling that isn't already counted by
+// light sampling at the previous bounce. A pdf of zero means the ray came from
+// the camera, so there was no light sample to share with.
+float emission_weight(World* world, Ray ray, Hit hit, float bsdf_probability)
+{
+    if(bsdf_probability <= 0.0f || hit.light_index < 0)
+    {
+        return 1.0f;
+    }
+
+    float light_probability = light_pdf(world, ray.origin, ray.direction, hit);
+    return power_heuristic(bsdf_probability, light_probability);
+}
+
+// Past the roulette depth, a path survives with a chance that follows its
+// throughput, and survivors are scaled up to make up for the ones that were
+// cut. Paths that can barely carry any light are mostly cut early this way,
+// and the estimate stays unbiased.
+bool russian_roulette(const Tile* tile, Sampler* sampler, int depth, Float3* throughput)
+{
+    if(depth < tile->roulette_depth)
+    {
+        return true;
+    }
+
+    float survival = fmaxf(throughput->x, fmaxf(throughput->y, throughput->z));
+    survival = fminf(survival, 0.95f);
+    if(sampler_next_1d(sampler) >= survival)
+    {
+        return false;
+    }
+
+    *throughput = float3_divide(*throughput, survival);
+    return true;
+}
+
+static Float3 trace_path(Ray ray, const Tile* tile, Sampler* sampler)
+{
+    Float3 radiance = float3_zero;
+    Float3 throughput = float3_one;
+    float bsdf_probability = 0.0f;
+    World* world = tile->world;
+
+    int depth;
+    for(depth = 0; ; depth += 1)
+    {
+        Hit hit = intersect_world(ray, world);
+        tile->counters->closest_hit_rays += 1;
+        Material material = world->materials[hit.material_index];
+
+        float weight = emission_weight(world, ray, hit, bsdf_probability);
+        Float3 emission = float3_multiply(weight, material.emittance);
+        radiance = float3_add(radiance, float3_pointwise_multiply(throughput, emission));
+
+        if(!hit.material_index || depth >= tile->max_depth)
+        {
+            break;
+        }
+
+        Float3 point = float3_add(float3_multiply(hit.distance, ray.direction), ray.origin);
+        Float3 outgoing = float3_negate(ray.direction);
+        Float3 direct = estimate_direct_light(tile, point, hit.normal, outgoing, material, sampler);
+        radiance = float3_add(radiance, float3_pointwise_multiply(throughput, direct));
+
+        Float3 bounce_weight;
+        bool scattered = scatter(&ray, hit, material, sampler, &bounce_weight, &bsdf_probability);
+        if(!scattered)
+        {
+            break;
+        }
+
+        throughput = float3_pointwise_multiply(throughput, bounce_weight);
+
+        if(!russian_roulette(tile, sampler, depth, &throughput))
+        {
+            break;
+        }
+    }
+
+    PROFILE_PATH_DEPTH(depth);
+
+    return radiance;
+}
+
+static float luminance(Float3 colour)
+{
+    return (0.2126f * colour.x) + (0.7152f * colour.y) + (0.0722f * colour.z);
+}
+
+bool accumulation_buffer_create(AccumulationBuffer* buffer, Int2 dimensions, Allocator* allocator)
+{
+    int pixels_count = dimensions.x * dimensions.y;
+
+    buffer->allocator = allocator;
+    buffer->dimensions = dimensions;
+    buffer->passes_count = 0;
+    buffer->sums = allocate(allocator, sizeof(Float3) * pixels_count);
+    buffer->luminance_squared_sums = allocate(allocator, sizeof(float) * pixels_count);
+    buffer->samples_counts = allocate(allocator, sizeof(int) * pixels_count);
+    buffer->converged = allocate(allocator, sizeof(bool) * pixels_count);
+
+    return buffer->sums && buffer->luminance_squared_sums && buffer->samples_counts && buffer->converged;
+}
+
+void accumulation_buffer_destroy(AccumulationBuffer* buffer)
+{
+    int pixels_count = buffer->dimensions.x * buffer->dimensions.y;
+
+    deallocate(buffer->allocator, buffer->sums, sizeof(Float3) * pixels_count);
+    deallocate(buffer->allocator, buffer->luminance_squared_sums, sizeof(float) * pixels_count);
+    deallocate(buffer->allocator, buffer->samples_counts, sizeof(int) * pixels_count);
+    deallocate(buffer->allocator, buffer->converged, sizeof(bool) * pixels_count);
+}
+
+void accumulation_buffer_resolve(AccumulationBuffer* buffer, Image* image)
+{
+    ASSERT(buffer->dimensions.x == image->dimensions.x);
+    ASSERT(buffer->dimensions.y == image->dimensions.y);
+
+    for(int y = 0; y < buffer->dimensions.y; y += 1)
+    {
+        for(int x = 0; x < buffer->dimensions.x; x += 1)
+        {
+            int pixel_index = (buffer->dimensions.x * y) + x;
+            int samples_count = buffer->samples_counts[pixel_index];
+
+            float scale = 0.0f;
+            if(samples_count > 0)
+            {
+                scale = 1.0f / samples_count;
+            }
+
+            Float3 sum = buffer->sums[pixel_index];
+            image_store_pixel(image, x, y, float3_multiply(scale, sum));
+        }
+    }
+}
+
+// Writes the mean radiance of each pixel in row y as red, green and blue
+// triples, without tone mapping.
+void accumulation_buffer_resolve_row(const AccumulationBuffer* buffer, int y, float* row)
+{
+    for(int x = 0; x < buffer->dimensions.x; x += 1)
+    {
+        int pixel_index = (buffer->dimensions.x * y) + x;
+        int samples_count = buffer->samples_counts[pixel_index];
+
+        float scale = 0.0f;
+        if(samples_count > 0)
+        {
+            scale = 1.0f / samples_count;
+        }
+
+        Float3 mean = float3_multiply(scale, buffer->sums[pixel_index]);
+        row[(3 * x) + 0] = mean.x;
+        row[(3 * x) + 1] = mean.y;
+        row[(3 * x) + 2] = mean.z;
+    }
+}
+
+// Marks pixels converged once they have max_samples, or at least min_samples
+// and a standard error of the mean luminance, relative to the mean, below the
+// threshold. Returns how many pixels are still unconverged.
+int accumulation_buffer_update_convergence(AccumulationBuffer* buffer, float error_threshold, int min_samples, int max_samples)
+{
+    ASSERT(min_samples >= 2);
+
+    int pixels_count = buffer->dimensions.x * buffer->dimensions.y;
+    int active_count = 0;
+
+    for(int pixel_index = 0; pixel_index < pixels_count; pixel_index += 1)
+    {
+        if(buffer->converged[pixel_index])
+        {
+            continue;
+        }
+
+        int n = buffer->samples_counts[pixel_index];
+        bool converged = n >= max_samples;
+
+        if(!converged && n >= min_samples)
+        {
+            float mean = luminance(buffer->sums[pixel_index]) / n;
+            float mean_of_squares = buffer->luminance_squared_sums[pixel_index] / n;
+            float variance = fmaxf(mean_of_squares - (mean * mean), 0.0f) * n / (n - 1);
+            float standard_error = sqrtf(variance / n);
+            converged = standard_error <= error_threshold * fmaxf(mean, 0.001f);
+        }
+
+        if(converged)
+        {
+            buffer->converged[pixel_index] = true;
+        }
+        else
+        {
+            active_count += 1;
+        }
+    }
+
+    return active_count;
+}
+
+void tile_add_sample(Tile* tile, int x, int y, Float3 sample)
+{
+    AccumulationBuffer* accumulation = tile->accumulation;
+    int pixel_index = (accumulation->dimensions.x * y) + x;
+    float sample_luminance = luminance(sample);
+
+    accumulation->sums[pixel_index] = float3_add(accumulation->sums[pixel_index], sample);
+    accumulation->luminance_squared_sums[pixel_index] += sample_luminance * sample_luminance;
+    accumulation->samples_counts[pixel_index] += 1;
+}
+
+bool tile_pixel_converged(const Tile* tile, int x, int y)
+{
+    AccumulationBuffer* accumulation = tile->accumulation;
+    return accumulation->converged[(accumulation->dimensions.x * y) + x];
+}
+
+int tile_pixel_samples_count(const Tile* tile, int x, int y)
+{
+    AccumulationBuffer* accumulation = tile->accumulation;
+    return accumulation->samples_counts[(accumulation->dimensions.x * y) + x];
+}
+
+// Converged pixels get no more samples, and no pixel is taken past the max.
+int tile_pixel_pass_samples(const Tile* tile, int x, int y)
+{
+    if(tile_pixel_converged(tile, x, y))
+    {
+        return 0;
+    }
+
+    int samples_count = tile->samples_per_pixel;
+    if(tile->max_samples > 0)
+    {
+        int remaining = tile->max_samples - tile_pixel_samples_count(tile, x, y);
+        if(remaining < samples_count)
+        {
+            samples_count = remaining > 0 ? remaining : 0;
+        }
+    }
+
+    return samples_count;
+}
+
+// Each sample is keyed by the pixel and the sample's index within that pixel,
+// so images are identical regardless of the tile size, thread count or order
+// in which tiles are taken.
+void tile_start_sample(const Tile* tile, Sampler* sampler, int x, int y, int sample_index)
+{
+    uint64_t pixel_index = ((uint64_t) tile->accumulation->dimensions.x * y) + x;
+    sampler_start(sampler, tile->sampler_type, tile->seed, pixel_index, (uint32_t) sample_index);
+}
+
+void render_tile_megakernel(Tile* tile)
+{
+    Rect region = tile->image_region;
+
+    int left = region.bottom_left.x;
+    int right = region.bottom_left.x + region.dimensions.x;
+    int bottom = region.bottom_left.y;
+    int top = region.bottom_left.y + region.dimensions.y;
+
+    Film film = film_create(tile->camera, tile->accumulation->dimensions);
+
+    for(int y = bottom; y < top; y += 1)
+    {
+        for(int x = left; x < right; x += 1)
+        {
+            int first_sample = tile_pixel_samples_count(tile, x, y);
+            int samples_count = tile_pixel_pass_samples(tile, x, y);
+
+            for(int sample_count = 0;
+                    sample_count < samples_count;
+                    sample_count += 1)
+            {
+                Sampler sampler;
+                tile_start_sample(tile, &sampler, x, y, first_sample + sample_count);
+
+                Ray ray = film_generate_ray(&film, x, y, &sampler);
+                tile->counters->primary_rays += 1;
+                Float3 sample = trace_path(ray, tile, &sampler);
+                tile_add_sample(tile, x, y, sample);
+            }
+        }
+    }
+}
+
+void render_tile(void* parameter)
+{
+    Tile* tile = parameter;
+
+    switch(tile->integrator)
+    {
+        case INTEGRATOR_MEGAKERNEL:
+        {
+            render_tile_megakernel(tile);
+            break;
+        }
+        case INTEGRATOR_WAVEFRONT:
+        {
+            // Both integrators take the same samples, so falling back only
+            // changes how quickly the tile is done.
+            if(!render_tile_wavefront(tile))
+            {
+                render_tile_megakernel(tile);
+            }
+            break;
+        }
+    }
+}
+
+static uint32_t compact_bits(uint32_t x)
+{
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff;
+    return x;
+}
+
+static Int2 morton_decode(uint32_t code)
+{
+    Int2 result;
+    result.x = (int) compact_bits(code);
+    result.y = (int) compact_bits(code >> 1);
+    return result;
+}
+
+bool tile_schedule_create(TileSchedule* schedule, Int2 image_dimensions, Int2 tile_dimensions, int bands_count, Allocator* allocator)
+{
+    ASSERT(tile_dimensions.x > 0 && tile_dimensions.y > 0);
+    ASSERT(bands_count > 0);
+
+    Int2 grid;
+    grid.x = (image_dimensions.x + tile_dimensions.x - 1) / tile_dimensions.x;
+    grid.y = (image_dimensions.y + tile_dimensions.y - 1) / tile_dimensions.y;
+
+    if(bands_count > grid.y)
+    {
+        bands_count = grid.y;
+    }
+
+    schedule->allocator = allocator;
+    schedule->thread_counters = NULL;
+    schedule->thread_counters_count = 0;
+    schedule->max_samples = 0;
+    schedule->tile_dimensions = tile_dimensions;
+    schedule->bands_count = bands_count;
+    schedule->tiles_count = grid.x * grid.y;
+    atomic_int_store(&schedule->next_thread_counters, 0);
+
+    schedule->bands = allocate(allocator, sizeof(TileBand) * bands_count);
+    schedule->tile_order = allocate(allocator, sizeof(Int2) * schedule->tiles_count);
+    if(!schedule->bands || !schedule->tile_order)
+    {
+        return false;
+    }
+
+    // Walk a square power-of-two grid in Morton order and skip the tiles that
+    // fall outside the image, once for each band. Codes are 32 bits, so each
+    // side can have at most 65536 tiles and the code count needs 64.
+    ASSERT(grid.x <= 65536 && grid.y <= 65536);
+    uint32_t side = 1;
+    while(side < (uint32_t) grid.x || side < (uint32_t) grid.y)
+    {
+        side <<= 1;
+    }
+
+    int count = 0;
+
+    for(int band_index = 0; band_index < bands_count; band_index += 1)
+    {
+        TileBand* band = &schedule->bands[band_index];
+        band->first = count;
+        atomic_int_store(&band->next_tile, 0);
+
+        uint64_t codes_count = (uint64_t) side * side;
+        for(uint64_t code = 0; code < codes_count; code += 1)
+        {
+            Int2 tile = morton_decode((uint32_t) code);
+            if(tile.x < grid.x && tile.y < grid.y && (tile.y * bands_count) / grid.y == band_index)
+            {
+                schedule->tile_order[count] = tile;
+                count += 1;
+            }
+        }
+
+        band->count = count - band->first;
+    }
+
+    ASSERT(count == schedule->tiles_count);
+
+    return true;
+}
+
+void tile_schedule_destroy(TileSchedule* schedule)
+{
+    if(schedule->bands)
+    {
+        deallocate(schedule->allocator, schedule->bands, sizeof(TileBand) * schedule->bands_count);
+        schedule->bands = NULL;
+    }
+    if(schedule->tile_order)
+    {
+        deallocate(schedule->allocator, schedule->tile_order, sizeof(Int2) * schedule->tiles_count);
+        schedule->tile_order = NULL;
+    }
+}
+
+static bool tile_has_unconverged_pixels(TileSchedule* schedule, Int2 tile)
+{
+    AccumulationBuffer* accumulation = schedule->accumulation;
+    Int2 bottom_left = int2_pointwise_multiply(tile, schedule->tile_dimensions);
+    int right = bottom_left.x + schedule->tile_dimensions.x;
+    int top = bottom_left.y + schedule->tile_dimensions.y;
+
+    if(right > accumulation->dimensions.x)
+    {
+        right = accumulation->dimensions.x;
+    }
+    if(top > accumulation->dimensions.y)
+    {
+        top = accumulation->dimensions.y;
+    }
+
+    for(int y = bottom_left.y; y < top; y += 1)
+    {
+        for(int x = bottom_left.x; x < right; x += 1)
+        {
+            if(!accumulation->converged[(accumulation->dimensions.x * y) + x])
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Converged pixels never become unconverged again, so compacting each band's
+// part of the tile order in place keeps the remaining tiles in Morton order.
+// Returns the number of tiles left to render.
+int tile_schedule_restart(TileSchedule* schedule)
+{
+    int count = 0;
+
+    for(int band_index = 0; band_index < schedule->bands_count; band_index += 1)
+    {
+        TileBand* band = &schedule->bands[band_index];
+        int first = count;
+
+        for(int tile_index = band->first;
+                tile_index < band->first + band->count;
+                tile_index += 1)
+        {
+            Int2 tile = schedule->tile_order[tile_index];
+            if(tile_has_unconverged_pixels(schedule, tile))
+            {
+                schedule->tile_order[count] = tile;
+                count += 1;
+            }
+        }
+
+        band->first = first;
+        band->count = count - first;
+        atomic_int_store(&band->next_tile, 0);
+    }
+
+    atomic_int_store(&schedule->next_thread_counters, 0);
+
+    return count;
+}
+
+void render_tiles(void* parameter)
+{
+    TileSchedule* schedule = parameter;
+    Int2 image_dimensions = schedule->accumulation->dimensions;
+
+    // Scratch memory for a tile comes from an arena of the thread's own, so
+    // threads don't contend for the heap.
+    Allocator arena;
+    arena_create(&arena, schedule->allocator, 1024 * 1024);
+
+    RenderCounters counters = {0};
+
+    Tile tile;
+    tile.accumulation = schedule->accumulation;
+    tile.allocator = &arena;
+    tile.camera = schedule->camera;
+    tile.counters = &counters;
+    tile.world = schedule->world;
+    tile.seed = schedule->seed;
+    tile.integrator = schedule->integrator;
+    tile.sampler_type = schedule->sampler_type;
+    tile.max_depth = schedule->max_depth;
+    tile.max_samples = schedule->max_samples;
+    tile.roulette_depth = schedule->roulette_depth;
+    tile.samples_per_pixel = schedule->samples_per_pixel;
+
+    // Start on the band for this thread's node and then go on to help with
+    // the rest.
+    int home_band = get_current_node();
+    if(home_band < 0)
+    {
+        home_band = 0;
+    }
+
+    TileBand* band = NULL;
+    int bands_tried = 0;
+
+    for(;;)
+    {
+        if(!band)
+        {
+            if(bands_tried == schedule->bands_count)
+            {
+                break;
+            }
+            band = &schedule->bands[(home_band + bands_tried) % schedule->bands_count];
+            bands_tried += 1;
+        }
+
+        long tile_index = atomic_int_add(&band->next_tile, 1) - 1;
+        if(tile_index >= band->count)
+        {
+            band = NULL;
+            continue;
+        }
+
+        Int2 bottom_left = int2_pointwise_multiply(schedule->tile_order[band->first + tile_index], schedule->tile_dimensions);
+        Int2 dimensions = schedule->tile_dimensions;
+
+        if(bottom_left.x + dimensions.x > image_dimensions.x)
+        {
+            dimensions.x = image_dimensions.x - bottom_left.x;
+        }
+        if(bottom_left.y + dimensions.y > image_dimensions.y)
+        {
+            dimensions.y = image_dimensions.y - bottom_left.y;
+        }
+
+        tile.image_region.bottom_left = bottom_left;
+        tile.image_region.dimensions = dimensions;
+
+        double start_time = get_time_seconds();
+        PROFILE_START(tile);
+        render_tile(&tile);
+        PROFILE_STOP_EVENT(tile, "tile");
+        arena_reset(&arena);
+        counters.busy_seconds += get_time_seconds() - start_time;
+        counters.tiles_count += 1;
+    }
+
+    arena_destroy(&arena);
+
+    if(schedule->thread_counters)
+    {
+        long index = atomic_int_add(&schedule->next_thread_counters, 1) - 1;
+        ASSERT(index < schedule->thread_counters_count);
+
+        RenderCounters* total = &schedule->thread_counters[index];
+        total->closest_hit_rays += counters.closest_hit_rays;
+        total->primary_rays += counters.primary_rays;
+        total->shadow_rays += counters.shadow_rays;
+        total->busy_seconds += counters.busy_seconds;
+        total->tiles_count += counters.tiles_count;
+    }
+}
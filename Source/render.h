@@ -0,0 +1,163 @@
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include "atomic.h"
+#include "memory.h"
+#include "sampler.h"
+#include "vector_math.h"
+#include "world.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef union PixelU32
+{
+    struct
+    {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    };
+    uint32_t value;
+} PixelU32;
+
+typedef struct Image
+{
+    Allocator* allocator;
+    PixelU32* pixels;
+    Int2 dimensions;
+} Image;
+
+typedef struct Rect
+{
+    Int2 bottom_left;
+    Int2 dimensions;
+} Rect;
+
+typedef struct Camera
+{
+    Float3 position;
+    Float3 target;
+    float field_of_view;
+} Camera;
+
+typedef enum Integrator
+{
+    INTEGRATOR_MEGAKERNEL,
+    INTEGRATOR_WAVEFRONT,
+} Integrator;
+
+// Running sums of linear radiance for each pixel, so that passes of samples
+// can keep being added and the image resolved from them after any pass.
+//
+// Each pixel also tracks its sample count and the sum of its squared sample
+// luminance, which give an estimate of the pixel's error. Once a pixel's
+// error is low enough it's marked converged and later passes skip it.
+typedef struct AccumulationBuffer
+{
+    Allocator* allocator;
+    Float3* sums;
+    float* luminance_squared_sums;
+    int* samples_counts;
+    bool* converged;
+    Int2 dimensions;
+    int passes_count;
+} AccumulationBuffer;
+
+// Work done by one thread while rendering. Closest hit rays are every query
+// for the nearest surface along a ray, including the primary rays from the
+// camera, and shadow rays are every occlusion query. Busy seconds is the time
+// spent rendering tiles, as opposed to waiting for or looking for them.
+typedef struct RenderCounters
+{
+    uint64_t closest_hit_rays;
+    uint64_t primary_rays;
+    uint64_t shadow_rays;
+    double busy_seconds;
+    int tiles_count;
+} RenderCounters;
+
+typedef struct Tile
+{
+    Rect image_region;
+    AccumulationBuffer* accumulation;
+    Allocator* allocator;
+    Camera* camera;
+    RenderCounters* counters;
+    World* world;
+    uint64_t seed;
+    Integrator integrator;
+    SamplerType sampler_type;
+    int max_depth;
+    int max_samples;
+    int roulette_depth;
+    int samples_per_pixel;
+} Tile;
+
+// A horizontal band of the image, whose tiles are handed out from a counter
+// of its own. It's padded so that neighbouring bands' counters don't share a
+// cache line.
+typedef struct TileBand
+{
+    AtomicInt next_tile;
+    int first;
+    int count;
+    uint8_t padding[64];
+} TileBand;
+
+// Splits an image into small tiles that threads take one at a time from a
+// shared counter. Tiles are handed out in Morton order so that tiles being
+// rendered at the same time are near each other in the image. Tiles along the
+// right and top edges are cropped to fit. Restarting it hands the tiles out
+// again for another pass, dropping any whose pixels have all converged.
+//
+// The image can be split into one band per memory node. A thread pinned to a
+// node takes tiles from that node's band first and only then helps with the
+// others. The rows of a band are contiguous in the accumulation buffer, so
+// the pages they're on tend to be first touched, and so placed, on the node
+// that goes on to use them.
+//
+// If thread counters are given, each call to render_tiles in a pass claims
+// one of them in turn and adds its counts to it. So there should be one for
+// every call made per pass.
+//
+// Max samples, if it's above zero, is the most samples any pixel gets over all
+// passes. A pass gives a pixel fewer samples than usual rather than go past
+// it.
+typedef struct TileSchedule
+{
+    Allocator* allocator;
+    AccumulationBuffer* accumulation;
+    Camera* camera;
+    RenderCounters* thread_counters;
+    World* world;
+    TileBand* bands;
+    Int2* tile_order;
+    Int2 tile_dimensions;
+    uint64_t seed;
+    AtomicInt next_thread_counters;
+    Integrator integrator;
+    SamplerType sampler_type;
+    int bands_count;
+    int max_depth;
+    int max_samples;
+    int roulette_depth;
+    int samples_per_pixel;
+    int thread_counters_count;
+    int tiles_count;
+} TileSchedule;
+
+bool accumulation_buffer_create(AccumulationBuffer* buffer, Int2 dimensions, Allocator* allocator);
+void accumulation_buffer_destroy(AccumulationBuffer* buffer);
+void accumulation_buffer_resolve(AccumulationBuffer* buffer, Image* image);
+void accumulation_buffer_resolve_row(const AccumulationBuffer* buffer, int y, float* row);
+int accumulation_buffer_update_convergence(AccumulationBuffer* buffer, float error_threshold, int min_samples, int max_samples);
+void image_destroy(Image* image);
+void render_tile(void* parameter);
+void render_tiles(void* parameter);
+bool tile_schedule_create(TileSchedule* schedule, Int2 image_dimensions, Int2 tile_dimensions, int bands_count, Allocator* allocator);
+void tile_schedule_destroy(TileSchedule* schedule);
+int tile_schedule_restart(TileSchedule* schedule);
+
+#endif // RENDER_H_
@@ -0,0 +1,40 @@
+#ifndef SOURCE_RENDER_INTERNAL_H_
+#define SOURCE_RENDER_INTERNAL_H_
+
+#include "render.h"
+#include "sampler.h"
+
+// Everything needed to turn a pixel coordinate into a camera ray.
+typedef struct Film
+{
+    Matrix4 inverse_view;
+    Float3 position;
+    Int2 dimensions;
+    float half_pixel_height;
+    float half_pixel_width;
+    float scale_x;
+    float scale_y;
+} Film;
+
+Film film_create(Camera* camera, Int2 dimensions);
+Ray film_generate_ray(const Film* film, int x, int y, Sampler* sampler);
+
+void image_store_pixel(Image* image, int x, int y, Float3 colour);
+
+void tile_add_sample(Tile* tile, int x, int y, Float3 sample);
+bool tile_pixel_converged(const Tile* tile, int x, int y);
+int tile_pixel_samples_count(const Tile* tile, int x, int y);
+int tile_pixel_pass_samples(const Tile* tile, int x, int y);
+void tile_start_sample(const Tile* tile, Sampler* sampler, int x, int y, int sample_index);
+
+bool scatter(Ray* ray, Hit hit, Material material, Sampler* sampler, Float3* weight, float* pdf);
+Float3 estimate_direct_light(const Tile* tile, Float3 point, Float3 normal, Float3 outgoing, Material material, Sampler* sampler);
+float emission_weight(World* world, Ray ray, Hit hit, float bsdf_probability);
+bool russian_roulette(const Tile* tile, Sampler* sampler, int depth, Float3* throughput);
+
+// The wavefront integrator renders nothing and returns false if it can't get
+// the memory for its batch of paths.
+void render_tile_megakernel(Tile* tile);
+bool render_tile_wavefront(Tile* tile);
+
+#endif // SOURCE_RENDER_INTERNAL_H_
@@ -0,0 +1,197 @@
+#include "sampler.h"
+
+#include "assert.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+static const uint32_t primes[] =
+{
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+};
+
+static const int primes_count = sizeof(primes) / sizeof(*primes);
+
+static uint64_t mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+static uint32_t hash_dimension(uint64_t seed, uint64_t dimension)
+{
+    return (uint32_t) mix64(seed ^ mix64(dimension + UINT64_C(0x9e3779b97f4a7c15)));
+}
+
+static float uint32_to_unorm(uint32_t x)
+{
+    // Keep only the top 24 bits so that the result is exactly representable
+    // and stays below one.
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static uint32_t reverse_bits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+    x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Laine and Karras' hash, which only lets each bit be affected by the bits
+// below it. Applied to reversed bits, that's a nested uniform scramble of the
+// binary digits, which is what Owen scrambling does.
+static uint32_t laine_karras_permutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47c;
+    x ^= x * 0xb82f1e52;
+    x ^= x * 0xc7afe638;
+    x ^= x * 0x8d22f6e6;
+    return x;
+}
+
+static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed)
+{
+    x = reverse_bits(x);
+    x = laine_karras_permutation(x, seed);
+    return reverse_bits(x);
+}
+
+static uint32_t sobol_first_dimension(uint32_t index)
+{
+    return reverse_bits(index);
+}
+
+static uint32_t sobol_second_dimension(uint32_t index)
+{
+    uint32_t result = 0;
+    for(uint32_t v = UINT32_C(1) << 31; index; index >>= 1, v ^= v >> 1)
+    {
+        if(index & 1)
+        {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+static float radical_inverse(uint32_t index, uint32_t base)
+{
+    double inverse_base = 1.0 / base;
+    double digit_scale = inverse_base;
+    double result = 0.0;
+
+    while(index)
+    {
+        uint32_t digit = index % base;
+        result += digit * digit_scale;
+        digit_scale *= inverse_base;
+        index /= base;
+    }
+
+    float value = (float) result;
+    return value < 1.0f ? value : 0x1.fffffep-1f;
+}
+
+static float halton_sample(Sampler* sampler, int dimension)
+{
+    if(dimension >= primes_count)
+    {
+        return random_float_range(&sampler->generator, 0.0f, 1.0f);
+    }
+
+    float value = radical_inverse(sampler->sample_index, primes[dimension]);
+    float shift = uint32_to_unorm(hash_dimension(sampler->seed, (uint64_t) dimension));
+
+    value += shift;
+    if(value >= 1.0f)
+    {
+        value -= 1.0f;
+    }
+    return value;
+}
+
+void sampler_start(Sampler* sampler, SamplerType type, uint64_t frame_seed, uint64_t pixel_index, uint32_t sample_index)
+{
+    sampler->type = type;
+    sampler->sample_index = sample_index;
+    sampler->dimension = 0;
+    sampler->seed = mix64(frame_seed ^ mix64(pixel_index));
+
+    random_seed_sample(&sampler->generator, frame_seed, pixel_index, sample_index);
+}
+
+float sampler_next_1d(Sampler* sampler)
+{
+    int dimension = sampler->dimension;
+    sampler->dimension += 1;
+
+    switch(sampler->type)
+    {
+        case SAMPLER_TYPE_RANDOM:
+        {
+            return random_float_range(&sampler->generator, 0.0f, 1.0f);
+        }
+        case SAMPLER_TYPE_HALTON:
+        {
+            return halton_sample(sampler, dimension);
+        }
+        case SAMPLER_TYPE_SOBOL:
+        {
+            uint32_t seed = hash_dimension(sampler->seed, (uint64_t) dimension);
+            uint32_t index = nested_uniform_scramble(sampler->sample_index, seed);
+            uint32_t value = sobol_first_dimension(index);
+            return uint32_to_unorm(nested_uniform_scramble(value, hash_dimension(seed, 0)));
+        }
+    }
+
+    ASSERT(false);
+    return 0.0f;
+}
+
+Float2 sampler_next_2d(Sampler* sampler)
+{
+    Float2 result;
+
+    switch(sampler->type)
+    {
+        case SAMPLER_TYPE_RANDOM:
+        case SAMPLER_TYPE_HALTON:
+        {
+            result.x = sampler_next_1d(sampler);
+            result.y = sampler_next_1d(sampler);
+            break;
+        }
+        case SAMPLER_TYPE_SOBOL:
+        {
+            int dimension = sampler->dimension;
+            sampler->dimension += 2;
+
+            uint32_t seed = hash_dimension(sampler->seed, (uint64_t) dimension);
+            uint32_t index = nested_uniform_scramble(sampler->sample_index, seed);
+            uint32_t x = sobol_first_dimension(index);
+            uint32_t y = sobol_second_dimension(index);
+            result.x = uint32_to_unorm(nested_uniform_scramble(x, hash_dimension(seed, 0)));
+            result.y = uint32_to_unorm(nested_uniform_scramble(y, hash_dimension(seed, 1)));
+            break;
+        }
+    }
+
+    return result;
+}
+
+const char* sampler_type_name(SamplerType type)
+{
+    switch(type)
+    {
+        case SAMPLER_TYPE_RANDOM: return "random";
+        case SAMPLER_TYPE_HALTON: return "Halton";
+        case SAMPLER_TYPE_SOBOL:  return "Sobol";
+    }
+
+    return NULL;
+}
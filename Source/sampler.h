@@ -0,0 +1,44 @@
+// Sampler
+//
+// Hands out the sample values that a path consumes, one dimension at a time,
+// so that the same code can draw from independent random numbers or from a
+// low-discrepancy sequence. Every sample of a pixel starts at dimension zero
+// and each call moves on to the next dimensions, so a given dimension always
+// means the same thing, such as the film jitter or the direction of the
+// second bounce.
+//
+// The Sobol sampler is an Owen-scrambled Sobol sequence padded from pairs of
+// its first two dimensions, with each pair of dimensions shuffled and
+// scrambled by its own hash. The Halton sampler uses the radical inverse in
+// a different prime base per dimension, randomly shifted per pixel.
+
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include "random.h"
+#include "vector_math.h"
+
+#include <stdint.h>
+
+typedef enum SamplerType
+{
+    SAMPLER_TYPE_RANDOM,
+    SAMPLER_TYPE_HALTON,
+    SAMPLER_TYPE_SOBOL,
+} SamplerType;
+
+typedef struct Sampler
+{
+    RandomGenerator generator;
+    uint64_t seed;
+    uint32_t sample_index;
+    int dimension;
+    SamplerType type;
+} Sampler;
+
+void sampler_start(Sampler* sampler, SamplerType type, uint64_t frame_seed, uint64_t pixel_index, uint32_t sample_index);
+float sampler_next_1d(Sampler* sampler);
+Float2 sampler_next_2d(Sampler* sampler);
+const char* sampler_type_name(SamplerType type);
+
+#endif // SAMPLER_H_
@@ -0,0 +1,854 @@
+#include "scene.h"
+
+#include "filesystem.h"
+#include "obj.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENE_CACHE_VERSION 2
+#define SCENE_NAME_CAP 64
+#define SCENE_PATH_CAP 1024
+
+static const char cache_magic[8] = "PTSCENE";
+
+typedef struct MaterialName
+{
+    char name[SCENE_NAME_CAP];
+} MaterialName;
+
+typedef struct CacheDependency
+{
+    char path[SCENE_PATH_CAP];
+    FileStamp stamp;
+} CacheDependency;
+
+typedef struct CacheHeader
+{
+    char magic[8];
+    Camera camera;
+    uint32_t version;
+    int dependencies_count;
+    int materials_count;
+    int meshes_count;
+    int planes_count;
+    int spheres_count;
+    int triangles_count;
+    int nodes_count;
+    int primitives_count;
+} CacheHeader;
+
+// Byte offsets of each array in a cache file. Every array starts on a cache
+// line boundary.
+typedef struct CacheLayout
+{
+    uint64_t dependencies;
+    uint64_t materials;
+    uint64_t meshes;
+    uint64_t planes;
+    uint64_t spheres;
+    uint64_t triangles;
+    uint64_t nodes;
+    uint64_t primitive_indices;
+    uint64_t bytes;
+} CacheLayout;
+
+typedef struct Parser
+{
+    Allocator* allocator;
+    Camera* camera;
+    CacheDependency* dependencies;
+    MaterialName* material_names;
+    World* world;
+    const char* at;
+    const char* path;
+    int dependencies_cap;
+    int dependencies_count;
+    int line;
+    int material_names_cap;
+    int material_names_count;
+    int directory_length;
+} Parser;
+
+
+// Text Format..................................................................
+
+static bool grow(Allocator* allocator, void** array, int* cap, int needed, uint64_t element_size)
+{
+    if(needed <= *cap)
+    {
+        return true;
+    }
+
+    int new_cap = *cap > 0 ? *cap : 8;
+    while(new_cap < needed)
+    {
+        new_cap *= 2;
+    }
+
+    void* result = reallocate(allocator, *array, element_size * *cap, element_size * new_cap);
+    if(!result)
+    {
+        return false;
+    }
+
+    *array = result;
+    *cap = new_cap;
+
+    return true;
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool at_end_of_line(Parser* parser)
+{
+    while(is_space(*parser->at))
+    {
+        parser->at += 1;
+    }
+
+    char c = *parser->at;
+    return c == '\0' || c == '\n' || c == '#';
+}
+
+static bool report_error(Parser* parser, const char* message)
+{
+    fprintf(stderr, "%s:%i: %s\n", parser->path, parser->line, message);
+    return false;
+}
+
+static bool parse_word(Parser* parser, char* word, int cap)
+{
+    if(at_end_of_line(parser))
+    {
+        return false;
+    }
+
+    int length = 0;
+    while(*parser->at && !is_space(*parser->at) && *parser->at != '\n' && *parser->at != '#')
+    {
+        if(length + 1 >= cap)
+        {
+            return false;
+        }
+        word[length] = *parser->at;
+        length += 1;
+        parser->at += 1;
+    }
+    word[length] = '\0';
+
+    return true;
+}
+
+static bool parse_float(Parser* parser, float* value)
+{
+    if(at_end_of_line(parser))
+    {
+        return false;
+    }
+
+    char* end;
+    *value = strtof(parser->at, &end);
+    if(end == parser->at)
+    {
+        return false;
+    }
+    parser->at = end;
+
+    return true;
+}
+
+static bool parse_float3(Parser* parser, Float3* value)
+{
+    return parse_float(parser, &value->x)
+        && parse_float(parser, &value->y)
+        && parse_float(parser, &value->z);
+}
+
+static bool parse_material(Parser* parser, uint32_t* material_index)
+{
+    char name[SCENE_NAME_CAP];
+    if(!parse_word(parser, name, SCENE_NAME_CAP))
+    {
+        return false;
+    }
+
+    for(int index = 0; index < parser->material_names_count; index += 1)
+    {
+        if(strcmp(parser->material_names[index].name, name) == 0)
+        {
+            // The background is material zero, so named ones start at one.
+            *material_index = (uint32_t) index + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool add_dependency(Parser* parser, const char* path)
+{
+    if(strlen(path) >= SCENE_PATH_CAP)
+    {
+        return false;
+    }
+
+    bool grown = grow(parser->allocator, (void**) &parser->dependencies, &parser->dependencies_cap, parser->dependencies_count + 1, sizeof(CacheDependency));
+    if(!grown)
+    {
+        return false;
+    }
+
+    CacheDependency* dependency = &parser->dependencies[parser->dependencies_count];
+    if(!get_file_stamp(path, &dependency->stamp))
+    {
+        return false;
+    }
+    strcpy(dependency->path, path);
+    parser->dependencies_count += 1;
+
+    return true;
+}
+
+static bool parse_statement(Parser* parser, const char* keyword)
+{
+    World* world = parser->world;
+
+    if(strcmp(keyword, "camera") == 0)
+    {
+        Camera* camera = parser->camera;
+        float degrees;
+        if(!parse_float3(parser, &camera->position)
+                || !parse_float3(parser, &camera->target)
+                || !parse_float(parser, &degrees))
+        {
+            return report_error(parser, "A camera needs a position, a target and a field of view.");
+        }
+        camera->field_of_view = degrees * (float) M_PI / 180.0f;
+    }
+    else if(strcmp(keyword, "background") == 0)
+    {
+        if(!parse_float3(parser, &world->materials[0].emittance))
+        {
+            return report_error(parser, "The background needs an emittance.");
+        }
+    }
+    else if(strcmp(keyword, "material") == 0)
+    {
+        MaterialName name;
+        Material material;
+        if(!parse_word(parser, name.name, SCENE_NAME_CAP)
+                || !parse_float3(parser, &material.emittance)
+                || !parse_float3(parser, &material.reflectance)
+                || !parse_float(parser, &material.glossiness))
+        {
+            return report_error(parser, "A material needs a name, an emittance, a reflectance and a glossiness.");
+        }
+
+        bool grown = grow(parser->allocator, (void**) &parser->material_names, &parser->material_names_cap, parser->material_names_count + 1, sizeof(MaterialName));
+        if(!grown || world_add_material(world, material) == -1)
+        {
+            return report_error(parser, "Couldn't add the material.");
+        }
+        parser->material_names[parser->material_names_count] = name;
+        parser->material_names_count += 1;
+    }
+    else if(strcmp(keyword, "plane") == 0)
+    {
+        Plane plane;
+        if(!parse_float3(parser, &plane.normal)
+                || !parse_float(parser, &plane.d)
+                || !parse_material(parser, &plane.material_index))
+        {
+            return report_error(parser, "A plane needs a normal, a distance and a known material.");
+        }
+        plane.normal = float3_normalise(plane.normal);
+
+        if(world_add_plane(world, plane) == -1)
+        {
+            return report_error(parser, "Couldn't add the plane.");
+        }
+    }
+    else if(strcmp(keyword, "sphere") == 0)
+    {
+        Sphere sphere;
+        if(!parse_float3(parser, &sphere.center)
+                || !parse_float(parser, &sphere.radius)
+                || !parse_material(parser, &sphere.material_index))
+        {
+            return report_error(parser, "A sphere needs a center, a radius and a known material.");
+        }
+
+        if(world_add_sphere(world, sphere) == -1)
+        {
+            return report_error(parser, "Couldn't add the sphere.");
+        }
+    }
+    else if(strcmp(keyword, "triangle") == 0)
+    {
+        Triangle triangle;
+        uint32_t material_index;
+        if(!parse_float3(parser, &triangle.vertices[0])
+                || !parse_float3(parser, &triangle.vertices[1])
+                || !parse_float3(parser, &triangle.vertices[2])
+                || !parse_material(parser, &material_index))
+        {
+            return report_error(parser, "A triangle needs three vertices and a known material.");
+        }
+
+        if(world_add_mesh(world, &triangle, 1, material_index) == -1)
+        {
+            return report_error(parser, "Couldn't add the triangle.");
+        }
+    }
+    else if(strcmp(keyword, "mesh") == 0)
+    {
+        char path[SCENE_PATH_CAP];
+        copy_memory(path, parser->path, parser->directory_length);
+
+        uint32_t material_index;
+        if(!parse_word(parser, path + parser->directory_length, SCENE_PATH_CAP - parser->directory_length)
+                || !parse_material(parser, &material_index))
+        {
+            return report_error(parser, "A mesh needs a file and a known material.");
+        }
+
+        ObjMesh mesh;
+        if(!add_dependency(parser, path) || !obj_load_file(&mesh, path, parser->allocator))
+        {
+            return report_error(parser, "Couldn't load the mesh.");
+        }
+
+        int mesh_index = world_add_mesh(world, mesh.triangles, mesh.triangles_count, material_index);
+        obj_destroy(&mesh);
+
+        if(mesh_index == -1)
+        {
+            return report_error(parser, "Couldn't add the mesh.");
+        }
+    }
+    else
+    {
+        return report_error(parser, "Unknown statement.");
+    }
+
+    if(!at_end_of_line(parser))
+    {
+        return report_error(parser, "Unexpected text at the end of the line.");
+    }
+
+    return true;
+}
+
+static bool parse_scene(Parser* parser, const char* contents)
+{
+    parser->at = contents;
+
+    for(parser->line = 1; *parser->at; parser->line += 1)
+    {
+        char keyword[SCENE_NAME_CAP];
+        if(!at_end_of_line(parser))
+        {
+            if(!parse_word(parser, keyword, SCENE_NAME_CAP))
+            {
+                return report_error(parser, "Unknown statement.");
+            }
+            if(!parse_statement(parser, keyword))
+            {
+                return false;
+            }
+        }
+
+        while(*parser->at && *parser->at != '\n')
+        {
+            parser->at += 1;
+        }
+        if(*parser->at == '\n')
+        {
+            parser->at += 1;
+        }
+    }
+
+    return true;
+}
+
+static int get_directory_length(const char* path)
+{
+    int length = 0;
+    for(int index = 0; path[index]; index += 1)
+    {
+        if(path[index] == '/' || path[index] == '\\')
+        {
+            length = index + 1;
+        }
+    }
+    return length;
+}
+
+
+// Cache........................................................................
+
+static uint64_t align_to_cache_line(uint64_t offset)
+{
+    return (offset + 63) & ~UINT64_C(63);
+}
+
+static CacheLayout lay_out_cache(const CacheHeader* header)
+{
+    CacheLayout layout;
+    layout.dependencies = align_to_cache_line(sizeof(CacheHeader));
+    layout.materials = align_to_cache_line(layout.dependencies + (sizeof(CacheDependency) * header->dependencies_count));
+    layout.meshes = align_to_cache_line(layout.materials + (sizeof(Material) * header->materials_count));
+    layout.planes = align_to_cache_line(layout.meshes + (sizeof(Mesh) * header->meshes_count));
+    layout.spheres = align_to_cache_line(layout.planes + (sizeof(Plane) * header->planes_count));
+    layout.triangles = align_to_cache_line(layout.spheres + (sizeof(Sphere) * header->spheres_count));
+    layout.nodes = align_to_cache_line(layout.triangles + (sizeof(Triangle) * header->triangles_count));
+    layout.primitive_indices = align_to_cache_line(layout.nodes + (sizeof(BvhNode) * header->nodes_count));
+    layout.bytes = layout.primitive_indices + (sizeof(int) * header->primitives_count);
+    return layout;
+}
+
+static void save_cache(const char* path, const World* world, const Camera* camera, const CacheDependency* dependencies, int dependencies_count, Allocator* allocator)
+{
+    CacheHeader header;
+    zero_memory(&header, sizeof(header));
+    copy_memory(header.magic, cache_magic, sizeof(cache_magic));
+    header.camera = *camera;
+    header.version = SCENE_CACHE_VERSION;
+    header.dependencies_count = dependencies_count;
+    header.materials_count = world->materials_count;
+    header.meshes_count = world->meshes_count;
+    header.planes_count = world->planes_count;
+    header.spheres_count = world->spheres_count;
+    header.triangles_count = world->triangles_count;
+    header.nodes_count = world->bvh.nodes_count;
+    header.primitives_count = world->bvh.primitives_count;
+
+    CacheLayout layout = lay_out_cache(&header);
+
+    uint8_t* contents = allocate(allocator, layout.bytes);
+    if(!contents)
+    {
+        return;
+    }
+
+    copy_memory(contents, &header, sizeof(header));
+    copy_memory(contents + layout.dependencies, dependencies, sizeof(CacheDependency) * dependencies_count);
+    copy_memory(contents + layout.materials, world->materials, sizeof(Material) * world->materials_count);
+    copy_memory(contents + layout.meshes, world->meshes, sizeof(Mesh) * world->meshes_count);
+    copy_memory(contents + layout.planes, world->planes, sizeof(Plane) * world->planes_count);
+    copy_memory(contents + layout.spheres, world->spheres, sizeof(Sphere) * world->spheres_count);
+    copy_memory(contents + layout.triangles, world->triangles, sizeof(Triangle) * world->triangles_count);
+    copy_memory(contents + layout.nodes, world->bvh.nodes, sizeof(BvhNode) * world->bvh.nodes_count);
+    copy_memory(contents + layout.primitive_indices, world->bvh.primitive_indices, sizeof(int) * world->bvh.primitives_count);
+
+    if(!save_whole_file(path, contents, layout.bytes))
+    {
+        fprintf(stderr, "Couldn't save the scene cache %s.\n", path);
+    }
+
+    deallocate(allocator, contents, layout.bytes);
+}
+
+// A stale or damaged cache is just passed over, so this only checks enough to
+// be sure that nothing it holds refers outside of the arrays it's in.
+static bool validate_cache(const FileMapping* mapping, const CacheHeader* header, Allocator* allocator)
+{
+    if(memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0
+            || header->version != SCENE_CACHE_VERSION
+            || header->dependencies_count < 0
+            || header->materials_count < 1
+            || header->meshes_count < 0
+            || header->planes_count < 0
+            || header->spheres_count < 0
+            || header->triangles_count < 0
+            || header->nodes_count < 1
+            || header->primitives_count != header->triangles_count + header->spheres_count)
+    {
+        return false;
+    }
+
+    CacheLayout layout = lay_out_cache(header);
+    if(layout.bytes != mapping->bytes)
+    {
+        return false;
+    }
+
+    const uint8_t* contents = mapping->contents;
+
+    const CacheDependency* dependencies = (const CacheDependency*) (contents + layout.dependencies);
+    for(int index = 0; index < header->dependencies_count; index += 1)
+    {
+        CacheDependency dependency = dependencies[index];
+        dependency.path[SCENE_PATH_CAP - 1] = '\0';
+
+        FileStamp stamp;
+        if(!get_file_stamp(dependency.path, &stamp)
+                || stamp.bytes != dependency.stamp.bytes
+                || stamp.modified_time != dependency.stamp.modified_time)
+        {
+            return false;
+        }
+    }
+
+    uint32_t materials_count = (uint32_t) header->materials_count;
+
+    const Mesh* meshes = (const Mesh*) (contents + layout.meshes);
+    int triangles_total = 0;
+    for(int index = 0; index < header->meshes_count; index += 1)
+    {
+        if(meshes[index].first_triangle != triangles_total
+                || meshes[index].triangles_count < 0
+                || meshes[index].triangles_count > header->triangles_count - triangles_total
+                || meshes[index].material_index >= materials_count)
+        {
+            return false;
+        }
+        triangles_total += meshes[index].triangles_count;
+    }
+    if(triangles_total != header->triangles_count)
+    {
+        return false;
+    }
+
+    const Plane* planes = (const Plane*) (contents + layout.planes);
+    for(int index = 0; index < header->planes_count; index += 1)
+    {
+        if(planes[index].material_index >= materials_count)
+        {
+            return false;
+        }
+    }
+
+    const Sphere* spheres = (const Sphere*) (contents + layout.spheres);
+    for(int index = 0; index < header->spheres_count; index += 1)
+    {
+        if(spheres[index].material_index >= materials_count)
+        {
+            return false;
+        }
+    }
+
+    const BvhNode* nodes = (const BvhNode*) (contents + layout.nodes);
+    for(int index = 0; index < header->nodes_count; index += 1)
+    {
+        // An empty hierarchy is a single leaf with nothing in it. The unused
+        // node at index 1 is left zeroed.
+        BvhNode node = nodes[index];
+        if(index == 1 && node.first == 0 && node.count == 0)
+        {
+            continue;
+        }
+
+        bool leaf = node.count > 0 || header->primitives_count == 0;
+        bool valid = leaf
+            ? node.first >= 0 && node.first <= header->primitives_count && node.count <= header->primitives_count - node.first
+            : node.first > index && node.first >= 2 && (node.first & 1) == 0 && node.first < header->nodes_count - 1;
+        if(!valid)
+        {
+            return false;
+        }
+    }
+
+    // Traversal keeps its stack in a fixed array, so walk the hierarchy the
+    // same way to be sure it's shallow enough. Children always come after
+    // their parent, so there are no cycles, but each node must also be
+    // reached only once for the walk to stay as small as the array.
+    int node_stack[BVH_MAX_DEPTH];
+    int stack_count = 1;
+    int visits_count = 0;
+    node_stack[0] = 0;
+    while(stack_count > 0)
+    {
+        stack_count -= 1;
+        BvhNode node = nodes[node_stack[stack_count]];
+
+        visits_count += 1;
+        if(visits_count > header->nodes_count)
+        {
+            return false;
+        }
+
+        if(node.count == 0 && header->primitives_count > 0)
+        {
+            if(stack_count + 2 > BVH_MAX_DEPTH)
+            {
+                return false;
+            }
+            node_stack[stack_count] = node.first;
+            node_stack[stack_count + 1] = node.first + 1;
+            stack_count += 2;
+        }
+    }
+
+    // The primitive arrays are sized by the number of each kind of primitive,
+    // so the indices have to be each primitive exactly once.
+    const int* primitive_indices = (const int*) (contents + layout.primitive_indices);
+    uint64_t seen_bytes = sizeof(uint32_t) * ((header->primitives_count / 32) + 1);
+    uint32_t* seen = allocate(allocator, seen_bytes);
+    if(!seen)
+    {
+        return false;
+    }
+
+    bool permutation = true;
+    for(int index = 0; index < header->primitives_count && permutation; index += 1)
+    {
+        int primitive_index = primitive_indices[index];
+        if(primitive_index < 0 || primitive_index >= header->primitives_count)
+        {
+            permutation = false;
+            break;
+        }
+
+        uint32_t bit = 1u << (primitive_index % 32);
+        permutation = !(seen[primitive_index / 32] & bit);
+        seen[primitive_index / 32] |= bit;
+    }
+
+    deallocate(allocator, seen, seen_bytes);
+
+    return permutation;
+}
+
+static bool load_cache(const char* path, World* world, Camera* camera)
+{
+    FileMapping mapping;
+    if(!map_file(&mapping, path))
+    {
+        return false;
+    }
+
+    if(mapping.bytes < sizeof(CacheHeader))
+    {
+        unmap_file(&mapping);
+        return false;
+    }
+
+    const uint8_t* contents = mapping.contents;
+    const CacheHeader* header = (const CacheHeader*) contents;
+
+    if(!validate_cache(&mapping, header, world->allocator))
+    {
+        unmap_file(&mapping);
+        return false;
+    }
+
+    CacheLayout layout = lay_out_cache(header);
+
+    const Material* materials = (const Material*) (contents + layout.materials);
+    const Mesh* meshes = (const Mesh*) (contents + layout.meshes);
+    const Plane* planes = (const Plane*) (contents + layout.planes);
+    const Sphere* spheres = (const Sphere*) (contents + layout.spheres);
+    const Triangle* triangles = (const Triangle*) (contents + layout.triangles);
+    const BvhNode* nodes = (const BvhNode*) (contents + layout.nodes);
+    const int* primitive_indices = (const int*) (contents + layout.primitive_indices);
+
+    bool added = true;
+
+    for(int index = 0; index < header->materials_count && added; index += 1)
+    {
+        added = world_add_material(world, materials[index]) != -1;
+    }
+    for(int index = 0; index < header->meshes_count && added; index += 1)
+    {
+        Mesh mesh = meshes[index];
+        added = world_add_mesh(world, &triangles[mesh.first_triangle], mesh.triangles_count, mesh.material_index) != -1;
+    }
+    for(int index = 0; index < header->planes_count && added; index += 1)
+    {
+        added = world_add_plane(world, planes[index]) != -1;
+    }
+    for(int index = 0; index < header->spheres_count && added; index += 1)
+    {
+        added = world_add_sphere(world, spheres[index]) != -1;
+    }
+
+    bool loaded = added && world_load_bvh(world, nodes, header->nodes_count, primitive_indices, header->primitives_count);
+    if(loaded)
+    {
+        *camera = header->camera;
+    }
+
+    unmap_file(&mapping);
+
+    return loaded;
+}
+
+
+// Loading......................................................................
+
+static bool load_text(World* world, Camera* camera, const char* path, const char* cache_path)
+{
+    Allocator* allocator = world->allocator;
+
+    Parser parser;
+    zero_memory(&parser, sizeof(parser));
+    parser.allocator = allocator;
+    parser.camera = camera;
+    parser.world = world;
+    parser.path = path;
+    parser.directory_length = get_directory_length(path);
+
+    char* contents;
+    uint64_t bytes;
+    if(!add_dependency(&parser, path) || !load_whole_file(path, &contents, &bytes, allocator))
+    {
+        fprintf(stderr, "Couldn't read the scene %s.\n", path);
+        deallocate(allocator, parser.dependencies, sizeof(CacheDependency) * parser.dependencies_cap);
+        return false;
+    }
+
+    Camera default_camera =
+    {
+        .position = {0.0f, -5.0f, 1.0f},
+        .target = float3_zero,
+        .field_of_view = (float) M_PI_4,
+    };
+    *camera = default_camera;
+
+    Material background = {0};
+    bool loaded = world_add_material(world, background) != -1
+        && parse_scene(&parser, contents);
+
+    if(loaded)
+    {
+        loaded = world_build_bvh(world);
+        if(!loaded)
+        {
+            fprintf(stderr, "Failed to build the bounding volume hierarchy.\n");
+        }
+    }
+
+    if(loaded)
+    {
+        save_cache(cache_path, world, camera, parser.dependencies, parser.dependencies_count, allocator);
+    }
+
+    deallocate(allocator, contents, bytes + 1);
+    deallocate(allocator, parser.dependencies, sizeof(CacheDependency) * parser.dependencies_cap);
+    deallocate(allocator, parser.material_names, sizeof(MaterialName) * parser.material_names_cap);
+
+    return loaded;
+}
+
+bool scene_load(World* world, Camera* camera, const char* path, bool* loaded_from_cache)
+{
+    char cache_path[SCENE_PATH_CAP];
+    int written = snprintf(cache_path, SCENE_PATH_CAP, "%s.cache", path);
+    if(written < 0 || written >= SCENE_PATH_CAP)
+    {
+        fprintf(stderr, "The scene path %s is too long.\n", path);
+        return false;
+    }
+
+    *loaded_from_cache = load_cache(cache_path, world, camera);
+    if(*loaded_from_cache)
+    {
+        return true;
+    }
+
+    // The cache may have failed partway through filling the world.
+    TriangleLayout triangle_layout = world->triangle_layout;
+    Allocator* allocator = world->allocator;
+    world_destroy(world);
+    world_create(world, allocator);
+    world->triangle_layout = triangle_layout;
+
+    return load_text(world, camera, path, cache_path);
+}
+
+bool scene_create_demo(World* world, Camera* camera)
+{
+    Camera demo_camera =
+    {
+        .position = {0.0f, -5.0f, 1.0f},
+        .target = float3_zero,
+        .field_of_view = (float) M_PI_4,
+    };
+    *camera = demo_camera;
+
+    Material background =
+    {
+        .emittance = {0.3f, 0.4f, 0.5f},
+    };
+
+    Material red =
+    {
+        .reflectance = {0.5f, 0.5f, 0.5f},
+    };
+
+    Material cyan =
+    {
+        .reflectance = {0.7f, 0.5f, 0.3f},
+    };
+
+    Material boyfriend_material =
+    {
+        .reflectance = {0.7f, 0.5f, 0.3f},
+        .glossiness = 0.7f,
+    };
+
+    world_add_material(world, background);
+    int red_index = world_add_material(world, red);
+    int cyan_index = world_add_material(world, cyan);
+    int boyfriend_index = world_add_material(world, boyfriend_material);
+
+    Plane plane =
+    {
+        .normal = float3_unit_z,
+        .d = 0.0f,
+        .material_index = red_index,
+    };
+
+    Sphere sphere =
+    {
+        .center = {1.0f, 0.0f, 1.0f},
+        .radius = 1.0f,
+        .material_index = cyan_index,
+    };
+
+    Sphere small_fella =
+    {
+        .center = {-1.0f, -2.0f, 0.0f},
+        .radius = 0.5f,
+        .material_index = boyfriend_index,
+    };
+
+    Sphere yo =
+    {
+        .center = {-2.0f, 3.0f, 1.5f},
+        .radius = 1.0f,
+        .material_index = boyfriend_index,
+    };
+
+    Sphere hi =
+    {
+        .center = {1.0f, -3.0f, 0.5f},
+        .radius = 0.6f,
+        .material_index = boyfriend_index,
+    };
+
+    Triangle triang =
+    {
+        .vertices[0] = {-0.5f, -3.0f, 0.0f},
+        .vertices[2] = {1.0f, -2.0f, 0.0f},
+        .vertices[1] = {-0.5f, -3.0f, 1.0f},
+    };
+
+    world_add_mesh(world, &triang, 1, boyfriend_index);
+    world_add_plane(world, plane);
+    world_add_sphere(world, sphere);
+    world_add_sphere(world, small_fella);
+    world_add_sphere(world, yo);
+    world_add_sphere(world, hi);
+
+    return world_build_bvh(world);
+}
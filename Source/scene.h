@@ -0,0 +1,38 @@
+// Scene Files
+//
+// A scene is a text file with one statement per line. Anything after a # is a
+// comment. Names refer to materials declared on earlier lines and angles are
+// in degrees.
+//
+//     camera <position x y z> <target x y z> <field of view>
+//     background <emittance r g b>
+//     material <name> <emittance r g b> <reflectance r g b> <glossiness>
+//     plane <normal x y z> <d> <material>
+//     sphere <center x y z> <radius> <material>
+//     triangle <vertex x y z> <vertex x y z> <vertex x y z> <material>
+//     mesh <path to .obj file> <material>
+//
+// Mesh paths are relative to the scene file.
+//
+// Parsing the text and the meshes it refers to and then building the bounding
+// volume hierarchy can take a long time for big scenes. So the result is saved
+// next to the scene in a cache file, whose path is the scene's with .cache on
+// the end. The cache holds the world's flat arrays and its hierarchy as they
+// are in memory, so later runs map it and copy them straight in. It also notes
+// the size and modification time of every file the scene was read from, and
+// is ignored if any of them changed.
+
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "render.h"
+#include "world.h"
+
+#include <stdbool.h>
+
+// The world should be newly created, with its triangle layout chosen. The demo
+// scene is built in rather than read from a file.
+bool scene_create_demo(World* world, Camera* camera);
+bool scene_load(World* world, Camera* camera, const char* path, bool* loaded_from_cache);
+
+#endif // SCENE_H_
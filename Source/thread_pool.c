@@ -1,55 +1,419 @@
 #include "thread_pool_internal.h"
 
+#include "profile.h"
+
 #include <stddef.h>
 
+#define CPUS_CAP 1024
+
+// The pool thread running on this thread, if any.
+static THREAD_LOCAL Thread* current_thread;
+
+// The node this thread is pinned to, if any.
+static THREAD_LOCAL int current_node = -1;
+
+
+static bool cpu_info_less(CpuInfo a, CpuInfo b)
+{
+    if(a.node != b.node)
+    {
+        return a.node < b.node;
+    }
+    if(a.sibling_rank != b.sibling_rank)
+    {
+        return a.sibling_rank < b.sibling_rank;
+    }
+    return a.cpu < b.cpu;
+}
+
+int get_cpu_placements(CpuPlacement* placements, int cap)
+{
+    CpuInfo cpus[CPUS_CAP];
+    int cpus_count = get_cpu_topology(cpus, CPUS_CAP);
+
+    // Renumber the nodes densely, in the order they're first seen.
+    int node_names[CPUS_CAP];
+    int nodes_count = 0;
+
+    for(int cpu_index = 0; cpu_index < cpus_count; cpu_index += 1)
+    {
+        int node = 0;
+        while(node < nodes_count && node_names[node] != cpus[cpu_index].node)
+        {
+            node += 1;
+        }
+        if(node == nodes_count)
+        {
+            node_names[nodes_count] = cpus[cpu_index].node;
+            nodes_count += 1;
+        }
+        cpus[cpu_index].node = node;
+    }
+
+    // Within each node, the first processor of every core comes before any
+    // second ones.
+    for(int cpu_index = 1; cpu_index < cpus_count; cpu_index += 1)
+    {
+        CpuInfo cpu = cpus[cpu_index];
+        int insert_index = cpu_index;
+        while(insert_index > 0 && cpu_info_less(cpu, cpus[insert_index - 1]))
+        {
+            cpus[insert_index] = cpus[insert_index - 1];
+            insert_index -= 1;
+        }
+        cpus[insert_index] = cpu;
+    }
+
+    // Then deal them out from each node in turn.
+    int node_starts[CPUS_CAP + 1];
+    for(int cpu_index = cpus_count - 1; cpu_index >= 0; cpu_index -= 1)
+    {
+        node_starts[cpus[cpu_index].node] = cpu_index;
+    }
+    node_starts[nodes_count] = cpus_count;
+
+    int count = 0;
+
+    for(int round = 0; count < cpus_count && count < cap; round += 1)
+    {
+        for(int node = 0; node < nodes_count && count < cap; node += 1)
+        {
+            int cpu_index = node_starts[node] + round;
+            if(cpu_index < node_starts[node + 1])
+            {
+                placements[count].cpu = cpus[cpu_index].cpu;
+                placements[count].node = node;
+                count += 1;
+            }
+        }
+    }
+
+    return count;
+}
+
+bool pin_current_thread(CpuPlacement placement)
+{
+    if(!set_thread_affinity(placement.cpu))
+    {
+        return false;
+    }
+
+    current_node = placement.node;
+
+    return true;
+}
+
+int get_current_node(void)
+{
+    return current_node;
+}
+
 
 bool task_queue_create(TaskQueue* queue, Allocator* allocator)
 {
-    const int cap = 32;
+    const long cap = 4096;
 
     queue->allocator = allocator;
-    queue->cap = cap;
-    queue->tasks = allocate(allocator, sizeof(Task) * cap);
+    queue->mask = cap - 1;
+    queue->cells = allocate(allocator, sizeof(TaskCell) * cap);
 
-    return queue->tasks;
+    if(!queue->cells)
+    {
+        return false;
+    }
+
+    for(long index = 0; index < cap; index += 1)
+    {
+        atomic_int_store(&queue->cells[index].sequence, index);
+    }
+
+    atomic_int_store(&queue->enqueue_position, 0);
+    atomic_int_store(&queue->dequeue_position, 0);
+
+    return true;
 }
 
 void task_queue_destroy(TaskQueue* queue)
 {
-    deallocate(queue->allocator, queue->tasks, sizeof(Task) * queue->cap);
+    if(queue->cells)
+    {
+        deallocate(queue->allocator, queue->cells, sizeof(TaskCell) * (queue->mask + 1));
+        queue->cells = NULL;
+    }
 }
 
-void task_queue_add(TaskQueue* queue, Task task)
+bool task_queue_add(TaskQueue* queue, Task task)
 {
-    int head = (queue->tail + queue->count) % queue->cap;
-    queue->tasks[head] = task;
-    queue->count += 1;
+    TaskCell* cell;
+    long position = atomic_int_load(&queue->enqueue_position);
+
+    for(;;)
+    {
+        cell = &queue->cells[position & queue->mask];
+        long sequence = atomic_int_load(&cell->sequence);
+        long difference = sequence - position;
+
+        if(difference == 0)
+        {
+            if(atomic_int_compare_exchange(&queue->enqueue_position, position, position + 1))
+            {
+                break;
+            }
+        }
+        else if(difference < 0)
+        {
+            return false;
+        }
+
+        atomic_pause();
+        position = atomic_int_load(&queue->enqueue_position);
+    }
+
+    cell->task = task;
+    atomic_int_store(&cell->sequence, position + 1);
+
+    return true;
+}
+
+bool task_queue_remove(TaskQueue* queue, Task* task)
+{
+    TaskCell* cell;
+    long position = atomic_int_load(&queue->dequeue_position);
+
+    for(;;)
+    {
+        cell = &queue->cells[position & queue->mask];
+        long sequence = atomic_int_load(&cell->sequence);
+        long difference = sequence - (position + 1);
+
+        if(difference == 0)
+        {
+            if(atomic_int_compare_exchange(&queue->dequeue_position, position, position + 1))
+            {
+                break;
+            }
+        }
+        else if(difference < 0)
+        {
+            return false;
+        }
+
+        atomic_pause();
+        position = atomic_int_load(&queue->dequeue_position);
+    }
+
+    *task = cell->task;
+    atomic_int_store(&cell->sequence, position + queue->mask + 1);
+
+    return true;
 }
 
-bool task_queue_is_empty(TaskQueue* queue)
+
+static uint64_t get_task_buffer_bytes(long cap)
 {
-    return queue->count == 0;
+    return sizeof(TaskBuffer) + (sizeof(Task) * cap);
 }
 
-Task task_queue_remove(TaskQueue* queue)
+static Allocator* get_buffer_allocator(WorkDeque* deque, long cap)
 {
-    Task task = queue->tasks[queue->tail];
-    queue->count -= 1;
-    queue->tail = (queue->tail + 1) % queue->cap;
+    return cap == WORK_DEQUE_CAP && deque->buffer_pool ? deque->buffer_pool : deque->allocator;
+}
 
-    return task;
+static TaskBuffer* task_buffer_create(WorkDeque* deque, long cap)
+{
+    TaskBuffer* buffer = allocate(get_buffer_allocator(deque, cap), get_task_buffer_bytes(cap));
+    if(buffer)
+    {
+        buffer->cap = cap;
+    }
+    return buffer;
 }
 
+static void task_buffer_destroy(WorkDeque* deque, TaskBuffer* buffer)
+{
+    deallocate(get_buffer_allocator(deque, buffer->cap), buffer, get_task_buffer_bytes(buffer->cap));
+}
 
-void thread_pool_add_task(ThreadPool* pool, Task task)
+// The buffer pool is optional, and the first buffer comes from the allocator
+// without one.
+bool work_deque_create(WorkDeque* deque, Allocator* allocator, Allocator* buffer_pool)
 {
+    deque->allocator = allocator;
+    deque->buffer_pool = buffer_pool;
+    deque->retired = NULL;
+    atomic_int_store(&deque->bottom, 0);
+    atomic_int_store(&deque->top, 0);
+
+    TaskBuffer* buffer = task_buffer_create(deque, WORK_DEQUE_CAP);
+    atomic_pointer_store(&deque->buffer, buffer);
+
+    return buffer;
+}
+
+void work_deque_destroy(WorkDeque* deque)
+{
+    TaskBuffer* buffer = atomic_pointer_load(&deque->buffer);
+    if(buffer)
+    {
+        task_buffer_destroy(deque, buffer);
+        atomic_pointer_store(&deque->buffer, NULL);
+    }
+
+    while(deque->retired)
+    {
+        TaskBuffer* next = deque->retired->next_retired;
+        task_buffer_destroy(deque, deque->retired);
+        deque->retired = next;
+    }
+}
+
+bool work_deque_push(WorkDeque* deque, Task task)
+{
+    long bottom = atomic_int_load(&deque->bottom);
+    long top = atomic_int_load(&deque->top);
+    TaskBuffer* buffer = atomic_pointer_load(&deque->buffer);
+
+    if(bottom - top > buffer->cap - 1)
+    {
+        TaskBuffer* grown = task_buffer_create(deque, 2 * buffer->cap);
+        if(!grown)
+        {
+            return false;
+        }
+
+        for(long index = top; index < bottom; index += 1)
+        {
+            grown->tasks[index & (grown->cap - 1)] = buffer->tasks[index & (buffer->cap - 1)];
+        }
+
+        buffer->next_retired = deque->retired;
+        deque->retired = buffer;
+        atomic_pointer_store(&deque->buffer, grown);
+        buffer = grown;
+    }
+
+    buffer->tasks[bottom & (buffer->cap - 1)] = task;
+    atomic_int_store(&deque->bottom, bottom + 1);
+
+    return true;
+}
+
+bool work_deque_pop(WorkDeque* deque, Task* task)
+{
+    long bottom = atomic_int_load(&deque->bottom) - 1;
+    TaskBuffer* buffer = atomic_pointer_load(&deque->buffer);
+    atomic_int_store(&deque->bottom, bottom);
+    long top = atomic_int_load(&deque->top);
+
+    if(top > bottom)
+    {
+        atomic_int_store(&deque->bottom, bottom + 1);
+        return false;
+    }
+
+    *task = buffer->tasks[bottom & (buffer->cap - 1)];
+
+    if(top != bottom)
+    {
+        return true;
+    }
+
+    // This was the last task, so race any thieves for it.
+    bool won = atomic_int_compare_exchange(&deque->top, top, top + 1);
+    atomic_int_store(&deque->bottom, bottom + 1);
+
+    return won;
+}
+
+bool work_deque_steal(WorkDeque* deque, Task* task)
+{
+    long top = atomic_int_load(&deque->top);
+    long bottom = atomic_int_load(&deque->bottom);
+
+    if(top >= bottom)
+    {
+        return false;
+    }
+
+    TaskBuffer* buffer = atomic_pointer_load(&deque->buffer);
+    *task = buffer->tasks[top & (buffer->cap - 1)];
+
+    return atomic_int_compare_exchange(&deque->top, top, top + 1);
+}
+
+
+static void lock_queue(ThreadPool* pool)
+{
+    PROFILE_START(lock);
     mutex_lock(pool->queue_lock);
-    task_queue_add(&pool->queue, task);
-    mutex_unlock(pool->queue_lock);
-    condition_signal_one(pool->queue_nonempty);
+    PROFILE_STOP_TIME(lock, PROFILE_COUNTER_LOCK_WAIT_NANOSECONDS);
+}
+
+static void run_task(Task task)
+{
+    PROFILE_START(task);
+    task.call(task.parameter);
+    PROFILE_STOP_EVENT(task, "task");
+    PROFILE_COUNT(PROFILE_COUNTER_TASKS, 1);
 }
 
-ThreadPool* thread_pool_create(Allocator* allocator, int threads_count)
+static void wake_sleeping_thread(ThreadPool* pool)
+{
+    if(atomic_int_load(&pool->sleeping_threads) > 0)
+    {
+        lock_queue(pool);
+        condition_signal_one(pool->queue_nonempty);
+        mutex_unlock(pool->queue_lock);
+    }
+}
+
+static void finish_task(ThreadPool* pool)
+{
+    long pending = atomic_int_subtract(&pool->pending_tasks, 1);
+    if(pending == 0)
+    {
+        lock_queue(pool);
+        condition_signal_all(pool->task_done);
+        mutex_unlock(pool->queue_lock);
+    }
+}
+
+static bool run_shared_task(ThreadPool* pool)
+{
+    Task task;
+    if(!task_queue_remove(&pool->queue, &task))
+    {
+        return false;
+    }
+
+    atomic_int_subtract(&pool->queued_tasks, 1);
+    run_task(task);
+    finish_task(pool);
+
+    return true;
+}
+
+void thread_pool_add_task(ThreadPool* pool, Task task)
+{
+    atomic_int_add(&pool->pending_tasks, 1);
+
+    Thread* thread = current_thread;
+    bool pushed = thread && thread->pool == pool && work_deque_push(&thread->deque, task);
+
+    if(!pushed)
+    {
+        while(!task_queue_add(&pool->queue, task))
+        {
+            run_shared_task(pool);
+        }
+    }
+
+    atomic_int_add(&pool->queued_tasks, 1);
+
+    wake_sleeping_thread(pool);
+}
+
+ThreadPool* thread_pool_create(Allocator* allocator, int threads_count, const CpuPlacement* placements)
 {
     ThreadPool* pool = allocate(allocator, sizeof(ThreadPool));
 
@@ -96,6 +460,16 @@ ThreadPool* thread_pool_create(Allocator* allocator, int threads_count)
         return NULL;
     }
 
+    if(threads_count > 0)
+    {
+        pool->buffer_pool_created = pool_create(&pool->buffer_pool, allocator, get_task_buffer_bytes(WORK_DEQUE_CAP), threads_count);
+        if(!pool->buffer_pool_created)
+        {
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
     for(int thread_index = 0;
             thread_index < pool->threads_count;
             thread_index += 1)
@@ -103,14 +477,34 @@ ThreadPool* thread_pool_create(Allocator* allocator, int threads_count)
         Thread* thread = &pool->threads[thread_index];
         thread->pool = pool;
         thread->id = thread_index + 1;
+        thread->steal_seed = 2654435761u * (uint32_t) thread->id;
+        thread->pinned = placements != NULL;
+        if(placements)
+        {
+            thread->placement = placements[thread_index];
+        }
+
+        bool deque_created = work_deque_create(&thread->deque, allocator, &pool->buffer_pool);
+        if(!deque_created)
+        {
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+    }
 
-        bool created = thread_create(thread);
+    for(int thread_index = 0;
+            thread_index < pool->threads_count;
+            thread_index += 1)
+    {
+        bool created = thread_create(&pool->threads[thread_index]);
 
         if(!created)
         {
             thread_pool_destroy(pool);
             return NULL;
         }
+
+        pool->threads_created += 1;
     }
 
     return pool;
@@ -118,13 +512,16 @@ ThreadPool* thread_pool_create(Allocator* allocator, int threads_count)
 
 void thread_pool_destroy(ThreadPool* pool)
 {
-    mutex_lock(pool->queue_lock);
-    pool->quit = true;
-    condition_signal_all(pool->queue_nonempty);
-    mutex_unlock(pool->queue_lock);
+    if(pool->queue_lock)
+    {
+        mutex_lock(pool->queue_lock);
+        pool->quit = true;
+        condition_signal_all(pool->queue_nonempty);
+        mutex_unlock(pool->queue_lock);
+    }
 
     for(int thread_index = 0;
-            thread_index < pool->threads_count;
+            thread_index < pool->threads_created;
             thread_index += 1)
     {
         thread_join(&pool->threads[thread_index]);
@@ -132,62 +529,140 @@ void thread_pool_destroy(ThreadPool* pool)
 
     task_queue_destroy(&pool->queue);
     condition_destroy(pool->queue_nonempty);
+    condition_destroy(pool->task_done);
     mutex_destroy(pool->queue_lock);
 
     if(pool->threads)
     {
+        for(int thread_index = 0;
+                thread_index < pool->threads_count;
+                thread_index += 1)
+        {
+            work_deque_destroy(&pool->threads[thread_index].deque);
+        }
+
         deallocate(pool->allocator, pool->threads, sizeof(Thread) * pool->threads_count);
         pool->threads = NULL;
     }
 
+    if(pool->buffer_pool_created)
+    {
+        pool_destroy(&pool->buffer_pool);
+    }
+
     deallocate(pool->allocator, pool, sizeof(ThreadPool));
 }
 
 void thread_pool_wait_all(ThreadPool* pool)
 {
-    mutex_lock(pool->queue_lock);
+    // Help with shared tasks rather than only blocking, so that waiting on a
+    // pool with no threads still finishes.
+    for(;;)
+    {
+        while(run_shared_task(pool));
+
+        lock_queue(pool);
+        bool done = atomic_int_load(&pool->pending_tasks) == 0;
+        if(!done)
+        {
+            condition_wait(pool->task_done, pool->queue_lock);
+        }
+        mutex_unlock(pool->queue_lock);
 
-    while(pool->busy_threads != 0)
+        if(done)
+        {
+            break;
+        }
+    }
+}
+
+
+static uint32_t next_steal_index(Thread* thread)
+{
+    // xorshift32
+    uint32_t x = thread->steal_seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    thread->steal_seed = x;
+    return x;
+}
+
+static bool steal_task(Thread* thread, Task* task)
+{
+    ThreadPool* pool = thread->pool;
+    int count = pool->threads_count;
+    int first = (int) (next_steal_index(thread) % (uint32_t) count);
+
+    for(int attempt = 0; attempt < count; attempt += 1)
     {
-        condition_wait(pool->task_done, pool->queue_lock);
+        Thread* victim = &pool->threads[(first + attempt) % count];
+        if(victim != thread && work_deque_steal(&victim->deque, task))
+        {
+            return true;
+        }
     }
 
-    mutex_unlock(pool->queue_lock);
+    return false;
 }
 
+static bool find_task(Thread* thread, Task* task)
+{
+    bool found = work_deque_pop(&thread->deque, task)
+            || task_queue_remove(&thread->pool->queue, task)
+            || steal_task(thread, task);
+
+    if(found)
+    {
+        atomic_int_subtract(&thread->pool->queued_tasks, 1);
+    }
+
+    return found;
+}
 
 void* thread_start(Thread* thread)
 {
     ThreadPool* pool = thread->pool;
+    current_thread = thread;
+    PROFILE_THREAD_START("worker");
+
+    if(thread->pinned)
+    {
+        pin_current_thread(thread->placement);
+    }
 
     for(;;)
     {
-        mutex_lock(pool->queue_lock);
+        Task task;
 
-        while(task_queue_is_empty(&pool->queue) && !pool->quit)
+        if(find_task(thread, &task))
         {
-            condition_wait(pool->queue_nonempty, pool->queue_lock);
+            run_task(task);
+            finish_task(pool);
+            continue;
         }
 
-        if(pool->quit)
+        // A thread adding a task increments queued_tasks before checking for
+        // sleeping threads, and this thread registers as sleeping before
+        // checking queued_tasks, so one of the two always sees the other.
+        lock_queue(pool);
+        atomic_int_add(&pool->sleeping_threads, 1);
+
+        PROFILE_START(idle);
+        while(atomic_int_load(&pool->queued_tasks) == 0 && !pool->quit)
         {
-            mutex_unlock(pool->queue_lock);
-            break;
+            condition_wait(pool->queue_nonempty, pool->queue_lock);
         }
+        PROFILE_STOP_TIME(idle, PROFILE_COUNTER_IDLE_NANOSECONDS);
 
-        Task task = task_queue_remove(&pool->queue);
-        pool->busy_threads += 1;
-
+        atomic_int_subtract(&pool->sleeping_threads, 1);
+        bool quit = pool->quit;
         mutex_unlock(pool->queue_lock);
 
-        task.call(task.parameter);
-
-        mutex_lock(pool->queue_lock);
-
-        pool->busy_threads -= 1;
-        condition_signal_all(pool->task_done);
-
-        mutex_unlock(pool->queue_lock);
+        if(quit)
+        {
+            break;
+        }
     }
 
     return NULL;
@@ -3,6 +3,14 @@
 
 #include "memory.h"
 
+#include <stdbool.h>
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 typedef struct Condition Condition;
 typedef struct Mutex Mutex;
 
@@ -16,9 +24,34 @@ typedef struct Task
 
 typedef struct ThreadPool ThreadPool;
 
+// A logical processor to run a thread on, and the memory node closest to it.
+// Nodes are numbered from zero without gaps, whatever the platform calls them.
+typedef struct CpuPlacement
+{
+    int cpu;
+    int node;
+} CpuPlacement;
+
 int get_logical_core_count(void);
 uint64_t get_thread_id(void);
 
+// Fills in up to cap placements, one per logical processor this process may
+// run on, and returns how many there are. They're ordered so that any number
+// of threads taken from the front are spread evenly over the nodes, and
+// don't share a physical core until every core has a thread.
+int get_cpu_placements(CpuPlacement* placements, int cap);
+
+// Keeps the calling thread on the placement's processor from now on. Memory
+// the thread touches first is then usually given to it from its own node.
+bool pin_current_thread(CpuPlacement placement);
+
+// The node the calling thread was pinned to, or -1 if it wasn't.
+int get_current_node(void);
+
+// Seconds from an arbitrary fixed point, from a clock that never goes
+// backwards. Only differences between readings mean anything.
+double get_time_seconds(void);
+
 Condition* condition_create(Allocator* allocator);
 void condition_destroy(Condition* condition);
 void condition_signal_all(Condition* condition);
@@ -31,7 +64,9 @@ void mutex_lock(Mutex* mutex);
 void mutex_unlock(Mutex* mutex);
 
 void thread_pool_add_task(ThreadPool* pool, Task task);
-ThreadPool* thread_pool_create(Allocator* allocator, int threads_count);
+// If placements are given, there should be one for each thread, and each
+// thread pins itself to its own as it starts.
+ThreadPool* thread_pool_create(Allocator* allocator, int threads_count, const CpuPlacement* placements);
 void thread_pool_destroy(ThreadPool* pool);
 void thread_pool_wait_all(ThreadPool* pool);
 
@@ -6,40 +6,115 @@
 
 #include <stdbool.h>
 
+typedef struct TaskCell
+{
+    AtomicInt sequence;
+    Task task;
+} TaskCell;
+
+// Bounded multi-producer multi-consumer ring. Each cell's sequence number
+// says whether it's ready to be written or read at a given position, so
+// producers and consumers only contend on their own position counter.
 typedef struct TaskQueue
 {
     Allocator* allocator;
-    Task* tasks;
-    int cap;
-    int count;
-    int tail;
+    TaskCell* cells;
+    long mask;
+    AtomicInt enqueue_position;
+    AtomicInt dequeue_position;
 } TaskQueue;
 
+// Ring of tasks used by a work-stealing deque. Its capacity is always a power
+// of two. Buffers replaced when the deque grows are kept on a retired list,
+// because a thief may still be reading from them, and are freed along with
+// the deque.
+//
+// Every deque starts with a buffer of the same capacity, so those come from a
+// pool shared by the thread pool. Only buffers grown past that come from the
+// general allocator. The pool isn't thread-safe, but it's only touched while
+// the thread pool is created and destroyed.
+#define WORK_DEQUE_CAP 256
+
+typedef struct TaskBuffer
+{
+    struct TaskBuffer* next_retired;
+    long cap;
+    Task tasks[];
+} TaskBuffer;
+
+// Chase-Lev deque. Only the owning thread pushes and pops at the bottom,
+// while any other thread can steal from the top.
+typedef struct WorkDeque
+{
+    Allocator* allocator;
+    Allocator* buffer_pool;
+    AtomicInt bottom;
+    AtomicInt top;
+    AtomicPointer buffer;
+    TaskBuffer* retired;
+} WorkDeque;
+
 typedef struct Thread
 {
+    WorkDeque deque;
+    CpuPlacement placement;
     ThreadPool* pool;
     uint64_t handle;
+    uint32_t steal_seed;
     int id;
+    bool pinned;
 } Thread;
 
+// A logical processor as the platform describes it. Node is the platform's
+// own number for its memory node. Processors that share a physical core are
+// siblings, and sibling rank is a processor's place among them.
+typedef struct CpuInfo
+{
+    int cpu;
+    int node;
+    int sibling_rank;
+} CpuInfo;
+
+// Tasks added from outside the pool's threads go into the shared queue, and
+// tasks added by a pool thread go onto the bottom of its own deque. Idle
+// threads take from their own deque, then the shared queue, then steal. If
+// the shared queue is full, the adding thread runs queued tasks itself until
+// there's room.
+//
+// pending_tasks counts tasks added but not yet finished, which is what
+// thread_pool_wait_all waits on. queued_tasks counts tasks not yet taken by
+// any thread, so that idle threads know when to sleep.
 struct ThreadPool
 {
     TaskQueue queue;
+    Allocator buffer_pool;
     Allocator* allocator;
     Condition* queue_nonempty;
     Condition* task_done;
     Mutex* queue_lock;
     Thread* threads;
-    int busy_threads;
+    AtomicInt pending_tasks;
+    AtomicInt queued_tasks;
+    AtomicInt sleeping_threads;
     int threads_count;
+    int threads_created;
+    bool buffer_pool_created;
     bool quit;
 };
 
 bool task_queue_create(TaskQueue* queue, Allocator* allocator);
 void task_queue_destroy(TaskQueue* queue);
-void task_queue_add(TaskQueue* queue, Task task);
-bool task_queue_is_empty(TaskQueue* queue);
-Task task_queue_remove(TaskQueue* queue);
+bool task_queue_add(TaskQueue* queue, Task task);
+bool task_queue_remove(TaskQueue* queue, Task* task);
+
+bool work_deque_create(WorkDeque* deque, Allocator* allocator, Allocator* buffer_pool);
+void work_deque_destroy(WorkDeque* deque);
+bool work_deque_push(WorkDeque* deque, Task task);
+bool work_deque_pop(WorkDeque* deque, Task* task);
+bool work_deque_steal(WorkDeque* deque, Task* task);
+
+int get_cpu_topology(CpuInfo* cpus, int cap);
+bool set_thread_affinity(int cpu);
 
 bool thread_create(Thread* thread);
 void thread_join(Thread* thread);
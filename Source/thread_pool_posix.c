@@ -1,8 +1,17 @@
+// For the processor affinity calls.
+#define _GNU_SOURCE
+
 #include "thread_pool_internal.h"
 
 #include "assert.h"
 
+#include <dirent.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 
@@ -19,8 +28,16 @@ struct Mutex
 };
 
 
+// Counts only the processors this process is allowed to run on, which can be
+// fewer than are online when it's been restricted with taskset or cgroups.
 int get_logical_core_count(void)
 {
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        return CPU_COUNT(&allowed);
+    }
+
     return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
@@ -29,6 +46,144 @@ uint64_t get_thread_id(void)
     return (uint64_t) pthread_self();
 }
 
+double get_time_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec * 1e-9);
+}
+
+
+static bool read_first_line(const char* path, char* line, int cap)
+{
+    FILE* file = fopen(path, "r");
+    if(!file)
+    {
+        return false;
+    }
+
+    bool read = fgets(line, cap, file) != NULL;
+    fclose(file);
+
+    return read;
+}
+
+// Finds where a processor is in a list like "0-3,8,10-11", or returns -1 if
+// it isn't there.
+static int find_in_cpu_list(const char* list, int cpu)
+{
+    int position = 0;
+    const char* at = list;
+
+    while(*at >= '0' && *at <= '9')
+    {
+        char* end;
+        long first = strtol(at, &end, 10);
+        long last = first;
+        if(*end == '-')
+        {
+            at = end + 1;
+            last = strtol(at, &end, 10);
+        }
+
+        if(cpu >= first && cpu <= last)
+        {
+            return position + (cpu - (int) first);
+        }
+        position += (int) (last - first) + 1;
+
+        at = end;
+        if(*at == ',')
+        {
+            at += 1;
+        }
+    }
+
+    return -1;
+}
+
+// Each processor's directory holds a link named after its node, if the
+// kernel knows about nodes at all.
+static int get_cpu_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%i", cpu);
+
+    DIR* directory = opendir(path);
+    if(!directory)
+    {
+        return 0;
+    }
+
+    int node = 0;
+    for(struct dirent* entry = readdir(directory); entry; entry = readdir(directory))
+    {
+        if(strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+        {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+
+    closedir(directory);
+
+    return node;
+}
+
+static int get_cpu_sibling_rank(int cpu)
+{
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%i/topology/thread_siblings_list", cpu);
+
+    char siblings[256];
+    if(!read_first_line(path, siblings, sizeof(siblings)))
+    {
+        return 0;
+    }
+
+    int rank = find_in_cpu_list(siblings, cpu);
+    return rank > 0 ? rank : 0;
+}
+
+int get_cpu_topology(CpuInfo* cpus, int cap)
+{
+    cpu_set_t allowed;
+    bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    long online_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int count = 0;
+
+    for(int cpu = 0; cpu < CPU_SETSIZE && count < cap; cpu += 1)
+    {
+        bool usable = have_mask ? CPU_ISSET(cpu, &allowed) : cpu < online_count;
+        if(!usable)
+        {
+            continue;
+        }
+
+        cpus[count].cpu = cpu;
+        cpus[count].node = get_cpu_node(cpu);
+        cpus[count].sibling_rank = get_cpu_sibling_rank(cpu);
+        count += 1;
+    }
+
+    return count;
+}
+
+bool set_thread_affinity(int cpu)
+{
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
 
 Condition* condition_create(Allocator* allocator)
 {
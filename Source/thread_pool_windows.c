@@ -32,6 +32,60 @@ uint64_t get_thread_id(void)
     return (uint64_t) GetCurrentThreadId();
 }
 
+double get_time_seconds(void)
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+
+// Only the first processor group is used, which holds up to 64 processors.
+int get_cpu_topology(CpuInfo* cpus, int cap)
+{
+    DWORD_PTR process_mask;
+    DWORD_PTR system_mask;
+    if(!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+    {
+        process_mask = ~(DWORD_PTR) 0;
+    }
+
+    int processors_count = get_logical_core_count();
+    int count = 0;
+
+    for(int cpu = 0; cpu < processors_count && cpu < 8 * (int) sizeof(DWORD_PTR) && count < cap; cpu += 1)
+    {
+        if(!(process_mask & ((DWORD_PTR) 1 << cpu)))
+        {
+            continue;
+        }
+
+        UCHAR node;
+        if(!GetNumaProcessorNode((UCHAR) cpu, &node))
+        {
+            node = 0;
+        }
+
+        cpus[count].cpu = cpu;
+        cpus[count].node = node;
+        cpus[count].sibling_rank = 0;
+        count += 1;
+    }
+
+    return count;
+}
+
+bool set_thread_affinity(int cpu)
+{
+    if(cpu < 0 || cpu >= 8 * (int) sizeof(DWORD_PTR))
+    {
+        return false;
+    }
+
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) != 0;
+}
+
 
 Condition* condition_create(Allocator* allocator)
 {
@@ -68,6 +68,22 @@ Float3 float3_lerp(Float3 a, Float3 b, float t)
     return result;
 }
 
+// Duff et al., "Building an Orthonormal Basis, Revisited"
+void float3_make_basis(Float3 normal, Float3* tangent, Float3* bitangent)
+{
+    float sign = copysignf(1.0f, normal.z);
+    float a = -1.0f / (sign + normal.z);
+    float b = normal.x * normal.y * a;
+
+    tangent->x = 1.0f + (sign * normal.x * normal.x * a);
+    tangent->y = sign * b;
+    tangent->z = -sign * normal.x;
+
+    bitangent->x = b;
+    bitangent->y = sign + (normal.y * normal.y * a);
+    bitangent->z = -normal.y;
+}
+
 Float3 float3_multiply(float s, Float3 v)
 {
     Float3 result = {s * v.x, s * v.y, s * v.z};
@@ -47,6 +47,7 @@ Float3 float3_divide(Float3 v, float s);
 float float3_dot(Float3 a, Float3 b);
 float float3_length(Float3 v);
 Float3 float3_lerp(Float3 a, Float3 b, float t);
+void float3_make_basis(Float3 normal, Float3* tangent, Float3* bitangent);
 Float3 float3_multiply(float s, Float3 v);
 Float3 float3_negate(Float3 v);
 Float3 float3_normalise(Float3 v);
@@ -0,0 +1,259 @@
+// Wavefront Integrator
+//
+// Instead of following one path at a time to its end, a tile's paths are
+// kept in a queue and advanced together one bounce at a time. Each bounce
+// runs as separate stages over the whole queue: intersection, shading and
+// extension. Extension compacts the paths that are still alive to the front
+// of the next queue, so later bounces only touch live paths. The queue is
+// filled by the generation stage in fixed size batches to bound its memory.
+
+#include "render_internal.h"
+
+#include "profile.h"
+
+#include <stddef.h>
+
+#define WAVEFRONT_BATCH_SIZE 4096
+
+typedef struct PathState
+{
+    Sampler sampler;
+    Ray ray;
+    Float3 radiance;
+    Float3 throughput;
+    float bsdf_pdf;
+    int pixel_index;
+    int depth;
+} PathState;
+
+// The pixels getting samples this pass are listed with the index of their
+// first sample and how many they get. Generation works through them in order,
+// with the active pixel and sample marking where the next batch starts.
+typedef struct Wavefront
+{
+    Film film;
+    Hit* hits;
+    int* first_samples;
+    int* pixels;
+    int* samples_counts;
+    PathState* paths;
+    PathState* next_paths;
+    bool* alive;
+    Tile* tile;
+    World* world;
+    int active_pixel;
+    int active_sample;
+    int paths_count;
+} Wavefront;
+
+static void generate_camera_rays(Wavefront* wavefront, int samples_count)
+{
+    Rect region = wavefront->tile->image_region;
+
+    for(int index = 0; index < samples_count; index += 1)
+    {
+        int active_pixel = wavefront->active_pixel;
+        int pixel_index = wavefront->pixels[active_pixel];
+        int x = region.bottom_left.x + (pixel_index % region.dimensions.x);
+        int y = region.bottom_left.y + (pixel_index / region.dimensions.x);
+        int sample_index = wavefront->first_samples[active_pixel] + wavefront->active_sample;
+
+        wavefront->active_sample += 1;
+        if(wavefront->active_sample == wavefront->samples_counts[active_pixel])
+        {
+            wavefront->active_pixel += 1;
+            wavefront->active_sample = 0;
+        }
+
+        PathState* path = &wavefront->paths[index];
+        tile_start_sample(wavefront->tile, &path->sampler, x, y, sample_index);
+        path->ray = film_generate_ray(&wavefront->film, x, y, &path->sampler);
+        path->radiance = float3_zero;
+        path->throughput = float3_one;
+        path->bsdf_pdf = 0.0f;
+        path->pixel_index = pixel_index;
+        path->depth = 0;
+    }
+
+    wavefront->paths_count = samples_count;
+    wavefront->tile->counters->primary_rays += samples_count;
+}
+
+static void intersect_paths(Wavefront* wavefront)
+{
+    for(int index = 0; index < wavefront->paths_count; index += 1)
+    {
+        wavefront->hits[index] = intersect_world(wavefront->paths[index].ray, wavefront->world);
+    }
+
+    wavefront->tile->counters->closest_hit_rays += wavefront->paths_count;
+}
+
+static void accumulate(PathState* path, Float3 emittance)
+{
+    Float3 radiance = float3_pointwise_multiply(path->throughput, emittance);
+    path->radiance = float3_add(path->radiance, radiance);
+}
+
+static void finish_path(Wavefront* wavefront, PathState* path)
+{
+    Rect region = wavefront->tile->image_region;
+    int x = region.bottom_left.x + (path->pixel_index % region.dimensions.x);
+    int y = region.bottom_left.y + (path->pixel_index / region.dimensions.x);
+    tile_add_sample(wavefront->tile, x, y, path->radiance);
+    PROFILE_PATH_DEPTH(path->depth);
+}
+
+static void shade_paths(Wavefront* wavefront)
+{
+    Material* materials = wavefront->world->materials;
+
+    for(int index = 0; index < wavefront->paths_count; index += 1)
+    {
+        PathState* path = &wavefront->paths[index];
+        Hit hit = wavefront->hits[index];
+
+        Material material = materials[hit.material_index];
+        float weight = emission_weight(wavefront->world, path->ray, hit, path->bsdf_pdf);
+        accumulate(path, float3_multiply(weight, material.emittance));
+
+        if(!hit.material_index || path->depth >= wavefront->tile->max_depth)
+        {
+            finish_path(wavefront, path);
+            wavefront->alive[index] = false;
+            continue;
+        }
+
+        Float3 point = float3_add(float3_multiply(hit.distance, path->ray.direction), path->ray.origin);
+        Float3 outgoing = float3_negate(path->ray.direction);
+        Float3 direct = estimate_direct_light(wavefront->tile, point, hit.normal, outgoing, material, &path->sampler);
+        accumulate(path, direct);
+
+        Float3 bounce_weight;
+        bool scattered = scatter(&path->ray, hit, material, &path->sampler, &bounce_weight, &path->bsdf_pdf);
+        if(!scattered)
+        {
+            finish_path(wavefront, path);
+            wavefront->alive[index] = false;
+            continue;
+        }
+
+        path->throughput = float3_pointwise_multiply(path->throughput, bounce_weight);
+
+        if(!russian_roulette(wavefront->tile, &path->sampler, path->depth, &path->throughput))
+        {
+            finish_path(wavefront, path);
+            wavefront->alive[index] = false;
+            continue;
+        }
+
+        path->depth += 1;
+        wavefront->alive[index] = true;
+    }
+}
+
+static void extend_paths(Wavefront* wavefront)
+{
+    int count = 0;
+
+    for(int index = 0; index < wavefront->paths_count; index += 1)
+    {
+        if(wavefront->alive[index])
+        {
+            wavefront->next_paths[count] = wavefront->paths[index];
+            count += 1;
+        }
+    }
+
+    PathState* temp = wavefront->paths;
+    wavefront->paths = wavefront->next_paths;
+    wavefront->next_paths = temp;
+    wavefront->paths_count = count;
+}
+
+static void deallocate_buffers(Wavefront* wavefront, Allocator* allocator, int pixels_count)
+{
+    deallocate(allocator, wavefront->first_samples, sizeof(int) * pixels_count);
+    deallocate(allocator, wavefront->pixels, sizeof(int) * pixels_count);
+    deallocate(allocator, wavefront->samples_counts, sizeof(int) * pixels_count);
+    deallocate(allocator, wavefront->hits, sizeof(Hit) * WAVEFRONT_BATCH_SIZE);
+    deallocate(allocator, wavefront->paths, sizeof(PathState) * WAVEFRONT_BATCH_SIZE);
+    deallocate(allocator, wavefront->next_paths, sizeof(PathState) * WAVEFRONT_BATCH_SIZE);
+    deallocate(allocator, wavefront->alive, sizeof(bool) * WAVEFRONT_BATCH_SIZE);
+}
+
+bool render_tile_wavefront(Tile* tile)
+{
+    Rect region = tile->image_region;
+
+    int pixels_count = region.dimensions.x * region.dimensions.y;
+
+    Allocator* allocator = tile->allocator;
+
+    Wavefront wavefront;
+    wavefront.film = film_create(tile->camera, tile->accumulation->dimensions);
+    wavefront.tile = tile;
+    wavefront.world = tile->world;
+    wavefront.active_pixel = 0;
+    wavefront.active_sample = 0;
+    wavefront.paths_count = 0;
+
+    wavefront.first_samples = allocate(allocator, sizeof(int) * pixels_count);
+    wavefront.pixels = allocate(allocator, sizeof(int) * pixels_count);
+    wavefront.samples_counts = allocate(allocator, sizeof(int) * pixels_count);
+    wavefront.hits = allocate(allocator, sizeof(Hit) * WAVEFRONT_BATCH_SIZE);
+    wavefront.paths = allocate(allocator, sizeof(PathState) * WAVEFRONT_BATCH_SIZE);
+    wavefront.next_paths = allocate(allocator, sizeof(PathState) * WAVEFRONT_BATCH_SIZE);
+    wavefront.alive = allocate(allocator, sizeof(bool) * WAVEFRONT_BATCH_SIZE);
+
+    if(!wavefront.first_samples || !wavefront.pixels || !wavefront.samples_counts || !wavefront.hits || !wavefront.paths || !wavefront.next_paths || !wavefront.alive)
+    {
+        deallocate_buffers(&wavefront, allocator, pixels_count);
+        return false;
+    }
+
+    // Only pixels that haven't converged yet get samples, and no more than
+    // their max allows. Their sample counts are noted up front since they go
+    // up as paths finish.
+    int active_pixels_count = 0;
+    int samples_total = 0;
+
+    for(int pixel_index = 0; pixel_index < pixels_count; pixel_index += 1)
+    {
+        int x = region.bottom_left.x + (pixel_index % region.dimensions.x);
+        int y = region.bottom_left.y + (pixel_index / region.dimensions.x);
+        int samples_count = tile_pixel_pass_samples(tile, x, y);
+        if(samples_count > 0)
+        {
+            wavefront.first_samples[active_pixels_count] = tile_pixel_samples_count(tile, x, y);
+            wavefront.pixels[active_pixels_count] = pixel_index;
+            wavefront.samples_counts[active_pixels_count] = samples_count;
+            active_pixels_count += 1;
+            samples_total += samples_count;
+        }
+    }
+
+    for(int first_sample = 0;
+            first_sample < samples_total;
+            first_sample += WAVEFRONT_BATCH_SIZE)
+    {
+        int samples_count = samples_total - first_sample;
+        if(samples_count > WAVEFRONT_BATCH_SIZE)
+        {
+            samples_count = WAVEFRONT_BATCH_SIZE;
+        }
+
+        generate_camera_rays(&wavefront, samples_count);
+
+        while(wavefront.paths_count > 0)
+        {
+            intersect_paths(&wavefront);
+            shade_paths(&wavefront);
+            extend_paths(&wavefront);
+        }
+    }
+
+    deallocate_buffers(&wavefront, allocator, pixels_count);
+
+    return true;
+}
@@ -0,0 +1,777 @@
+#include "world.h"
+
+#include "assert.h"
+#include "profile.h"
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+
+// Returns the array grown so it can hold at least needed elements, or NULL
+// if the allocation failed, in which case the original array is untouched.
+static void* reserve(Allocator* allocator, void* array, int* cap, int needed, uint64_t element_size)
+{
+    if(needed <= *cap)
+    {
+        return array;
+    }
+
+    int new_cap = *cap > 0 ? *cap : 4;
+    while(new_cap < needed)
+    {
+        new_cap *= 2;
+    }
+
+    void* result = reallocate(allocator, array, element_size * *cap, element_size * new_cap);
+    if(result)
+    {
+        *cap = new_cap;
+    }
+
+    return result;
+}
+
+
+MaybeFloat intersect_ray_plane(Ray ray, Plane plane)
+{
+    MaybeFloat result;
+    result.valid = false;
+
+    float d = float3_dot(plane.normal, ray.direction);
+
+    if(fabsf(d) > 1e-6f)
+    {
+        float t = (-float3_dot(ray.origin, plane.normal) - plane.d) / d;
+        result.valid = t >= 0.0f;
+        result.value = t;
+    }
+
+    return result;
+}
+
+static Aabb get_primitive_bounds(World* world, Primitive primitive)
+{
+    Aabb result = aabb_empty();
+
+    switch(primitive.type)
+    {
+        case PRIMITIVE_TYPE_SPHERE:
+        {
+            Sphere* sphere = &world->spheres[primitive.index];
+            Float3 extent = {sphere->radius, sphere->radius, sphere->radius};
+            result.min = float3_subtract(sphere->center, extent);
+            result.max = float3_add(sphere->center, extent);
+            break;
+        }
+        case PRIMITIVE_TYPE_TRIANGLE:
+        {
+            Triangle* triangle = &world->triangles[primitive.index];
+            for(int vertex_index = 0; vertex_index < 3; vertex_index += 1)
+            {
+                result = aabb_merge_point(result, triangle->vertices[vertex_index]);
+            }
+            break;
+        }
+    }
+
+    return result;
+}
+
+static void destroy_primitive_arrays(World* world)
+{
+    triangle_soa_destroy(&world->triangle_soa);
+    sphere_soa_destroy(&world->sphere_soa);
+
+    if(world->triangle_prefix)
+    {
+        deallocate(world->allocator, world->triangle_prefix, sizeof(int) * (world->primitives_count + 1));
+        world->triangle_prefix = NULL;
+    }
+}
+
+// Lays the triangles and spheres out in structure-of-arrays form, in the order
+// the hierarchy's leaves reference them, for the vectorised kernels.
+static bool build_primitive_arrays(World* world)
+{
+    Bvh* bvh = &world->bvh;
+    int* indices = bvh->primitive_indices;
+
+    // Stable partition each leaf so that its triangles come first. Triangles
+    // are moved down in place and spheres set aside, then put back after them.
+    // Leaves from a cache aren't limited in size, so the spare room is made
+    // big enough for the largest.
+    int largest_leaf = 1;
+    for(int node_index = 0; node_index < bvh->nodes_count; node_index += 1)
+    {
+        if(bvh->nodes[node_index].count > largest_leaf)
+        {
+            largest_leaf = bvh->nodes[node_index].count;
+        }
+    }
+
+    int* leaf_spheres = allocate(world->allocator, sizeof(int) * largest_leaf);
+    if(!leaf_spheres)
+    {
+        return false;
+    }
+
+    for(int node_index = 0; node_index < bvh->nodes_count; node_index += 1)
+    {
+        BvhNode* node = &bvh->nodes[node_index];
+        int end = node->first + node->count;
+        int insert = node->first;
+        int spheres_count = 0;
+
+        for(int i = node->first; i < end; i += 1)
+        {
+            if(world->primitives[indices[i]].type == PRIMITIVE_TYPE_TRIANGLE)
+            {
+                indices[insert] = indices[i];
+                insert += 1;
+            }
+            else
+            {
+                leaf_spheres[spheres_count] = indices[i];
+                spheres_count += 1;
+            }
+        }
+
+        copy_memory(&indices[insert], leaf_spheres, sizeof(int) * spheres_count);
+    }
+
+    deallocate(world->allocator, leaf_spheres, sizeof(int) * largest_leaf);
+
+    bool created = triangle_soa_create(&world->triangle_soa, world->triangles_count, world->triangle_layout, world->allocator);
+    created = sphere_soa_create(&world->sphere_soa, world->spheres_count, world->allocator) && created;
+    world->triangle_prefix = allocate(world->allocator, sizeof(int) * (world->primitives_count + 1));
+
+    if(!created || !world->triangle_prefix)
+    {
+        destroy_primitive_arrays(world);
+        return false;
+    }
+
+    TriangleSoa* triangles = &world->triangle_soa;
+    SphereSoa* spheres = &world->sphere_soa;
+    int triangles_count = 0;
+    int spheres_count = 0;
+
+    for(int slot = 0; slot < world->primitives_count; slot += 1)
+    {
+        world->triangle_prefix[slot] = triangles_count;
+
+        int primitive_index = indices[slot];
+        Primitive primitive = world->primitives[primitive_index];
+
+        switch(primitive.type)
+        {
+            case PRIMITIVE_TYPE_SPHERE:
+            {
+                Sphere sphere = world->spheres[primitive.index];
+                for(int axis = 0; axis < 3; axis += 1)
+                {
+                    spheres->center[axis][spheres_count] = sphere.center.e[axis];
+                }
+                spheres->radius[spheres_count] = sphere.radius;
+                spheres->primitive_indices[spheres_count] = primitive_index;
+                spheres_count += 1;
+                break;
+            }
+            case PRIMITIVE_TYPE_TRIANGLE:
+            {
+                Triangle* triangle = &world->triangles[primitive.index];
+                triangle_soa_set(triangles, triangles_count, triangle->vertices, primitive_index);
+                triangles_count += 1;
+                break;
+            }
+        }
+    }
+
+    world->triangle_prefix[world->primitives_count] = triangles_count;
+
+    return true;
+}
+
+static bool is_emissive(Material material)
+{
+    return material.emittance.x > 0.0f || material.emittance.y > 0.0f || material.emittance.z > 0.0f;
+}
+
+static uint32_t get_primitive_material(const World* world, Primitive primitive)
+{
+    switch(primitive.type)
+    {
+        case PRIMITIVE_TYPE_SPHERE:
+        {
+            return world->spheres[primitive.index].material_index;
+        }
+        case PRIMITIVE_TYPE_TRIANGLE:
+        {
+            return world->meshes[primitive.mesh_index].material_index;
+        }
+    }
+
+    return 0;
+}
+
+static void destroy_lights(World* world)
+{
+    deallocate(world->allocator, world->lights, sizeof(Light) * world->lights_count);
+    world->lights = NULL;
+    world->lights_count = 0;
+    world->environment_light_index = -1;
+}
+
+static bool build_lights(World* world)
+{
+    bool environment_emits = world->materials_count > 0 && is_emissive(world->materials[0]);
+
+    int lights_count = environment_emits ? 1 : 0;
+    for(int index = 0; index < world->primitives_count; index += 1)
+    {
+        uint32_t material_index = get_primitive_material(world, world->primitives[index]);
+        if(is_emissive(world->materials[material_index]))
+        {
+            lights_count += 1;
+        }
+    }
+
+    if(lights_count == 0)
+    {
+        return true;
+    }
+
+    world->lights = allocate(world->allocator, sizeof(Light) * lights_count);
+    if(!world->lights)
+    {
+        return false;
+    }
+    world->lights_count = lights_count;
+
+    int light_index = 0;
+
+    if(environment_emits)
+    {
+        world->lights[light_index].type = LIGHT_TYPE_ENVIRONMENT;
+        world->lights[light_index].index = 0;
+        world->lights[light_index].material_index = 0;
+        world->environment_light_index = light_index;
+        light_index += 1;
+    }
+
+    for(int index = 0; index < world->primitives_count; index += 1)
+    {
+        Primitive* primitive = &world->primitives[index];
+        uint32_t material_index = get_primitive_material(world, *primitive);
+        if(is_emissive(world->materials[material_index]))
+        {
+            Light* light = &world->lights[light_index];
+            light->type = primitive->type == PRIMITIVE_TYPE_SPHERE ? LIGHT_TYPE_SPHERE : LIGHT_TYPE_TRIANGLE;
+            light->index = primitive->index;
+            light->material_index = material_index;
+            primitive->light_index = light_index;
+            light_index += 1;
+        }
+    }
+
+    return true;
+}
+
+// Lists the bounded primitives in a fixed order, meshes first and then
+// spheres, so that a hierarchy built over them earlier still matches.
+static bool build_primitives(World* world)
+{
+    Allocator* allocator = world->allocator;
+
+    if(world->primitives)
+    {
+        bvh_destroy(&world->bvh);
+        destroy_primitive_arrays(world);
+        deallocate(allocator, world->primitives, sizeof(Primitive) * world->primitives_count);
+        world->primitives = NULL;
+    }
+
+    destroy_lights(world);
+
+    int primitives_count = world->triangles_count + world->spheres_count;
+
+    world->primitives_count = primitives_count;
+    world->primitives = allocate(allocator, sizeof(Primitive) * primitives_count);
+
+    if(primitives_count > 0 && !world->primitives)
+    {
+        return false;
+    }
+
+    int primitive_index = 0;
+
+    for(int mesh_index = 0;
+            mesh_index < world->meshes_count;
+            mesh_index += 1)
+    {
+        Mesh* mesh = &world->meshes[mesh_index];
+        ASSERT(mesh->material_index < (uint32_t) world->materials_count);
+
+        for(int triangle_index = mesh->first_triangle;
+                triangle_index < mesh->first_triangle + mesh->triangles_count;
+                triangle_index += 1)
+        {
+            Primitive* primitive = &world->primitives[primitive_index];
+            primitive->type = PRIMITIVE_TYPE_TRIANGLE;
+            primitive->index = triangle_index;
+            primitive->light_index = -1;
+            primitive->mesh_index = mesh_index;
+            primitive_index += 1;
+        }
+    }
+
+    for(int sphere_index = 0;
+            sphere_index < world->spheres_count;
+            sphere_index += 1)
+    {
+        ASSERT(world->spheres[sphere_index].material_index < (uint32_t) world->materials_count);
+
+        Primitive* primitive = &world->primitives[primitive_index];
+        primitive->type = PRIMITIVE_TYPE_SPHERE;
+        primitive->index = sphere_index;
+        primitive->light_index = -1;
+        primitive->mesh_index = 0;
+        primitive_index += 1;
+    }
+
+    return build_lights(world);
+}
+
+bool world_build_bvh(World* world)
+{
+    Allocator* allocator = world->allocator;
+
+    if(!build_primitives(world))
+    {
+        return false;
+    }
+
+    int primitives_count = world->primitives_count;
+    Aabb* bounds = allocate(allocator, sizeof(Aabb) * primitives_count);
+    if(primitives_count > 0 && !bounds)
+    {
+        return false;
+    }
+
+    for(int index = 0; index < primitives_count; index += 1)
+    {
+        bounds[index] = get_primitive_bounds(world, world->primitives[index]);
+    }
+
+    bool built = bvh_build(&world->bvh, bounds, primitives_count, allocator);
+
+    deallocate(allocator, bounds, sizeof(Aabb) * primitives_count);
+
+    if(!built)
+    {
+        return false;
+    }
+
+    world->kernels = get_intersect_kernels(world->kernels.level, world->triangle_layout);
+
+    return build_primitive_arrays(world);
+}
+
+// Like world_build_bvh, but takes the hierarchy from an earlier build over the
+// same primitives instead of building it again.
+bool world_load_bvh(World* world, const BvhNode* nodes, int nodes_count, const int* primitive_indices, int primitives_count)
+{
+    if(!build_primitives(world) || primitives_count != world->primitives_count)
+    {
+        return false;
+    }
+
+    if(!bvh_load(&world->bvh, nodes, nodes_count, primitive_indices, primitives_count, world->allocator))
+    {
+        return false;
+    }
+
+    world->kernels = get_intersect_kernels(world->kernels.level, world->triangle_layout);
+
+    return build_primitive_arrays(world);
+}
+
+static const float min_hit_distance = 0.0001f;
+
+Hit intersect_world(Ray ray, World* world)
+{
+    Hit hit;
+    hit.distance = FLT_MAX;
+    hit.light_index = world->environment_light_index;
+    hit.material_index = 0;
+    hit.normal = float3_unit_z;
+
+    int hit_primitive = -1;
+    int hit_triangle = -1;
+
+    PROFILE_COUNT(PROFILE_COUNTER_RAYS, 1);
+
+    Bvh* bvh = &world->bvh;
+
+    Float3 inverse_direction;
+    inverse_direction.x = 1.0f / ray.direction.x;
+    inverse_direction.y = 1.0f / ray.direction.y;
+    inverse_direction.z = 1.0f / ray.direction.z;
+
+    int node_stack[BVH_MAX_DEPTH];
+    float entry_stack[BVH_MAX_DEPTH];
+    int stack_count = 0;
+
+    float root_entry;
+    if(world->primitives_count > 0
+            && aabb_intersect_ray(bvh->nodes[0].bounds, ray.origin, inverse_direction, hit.distance, &root_entry))
+    {
+        node_stack[0] = 0;
+        entry_stack[0] = root_entry;
+        stack_count = 1;
+    }
+
+    while(stack_count > 0)
+    {
+        stack_count -= 1;
+
+        if(entry_stack[stack_count] > hit.distance)
+        {
+            continue;
+        }
+
+        const BvhNode* node = &bvh->nodes[node_stack[stack_count]];
+        PROFILE_COUNT(PROFILE_COUNTER_BVH_NODES, 1);
+
+        if(node->count > 0)
+        {
+            // Triangles come before spheres within a leaf, so each kind is one
+            // contiguous run in its own array.
+            int triangles_first = world->triangle_prefix[node->first];
+            int triangles_count = world->triangle_prefix[node->first + node->count] - triangles_first;
+            int spheres_first = node->first - triangles_first;
+            int spheres_count = node->count - triangles_count;
+
+            PROFILE_COUNT(PROFILE_COUNTER_TRIANGLE_TESTS, triangles_count);
+            PROFILE_COUNT(PROFILE_COUNTER_SPHERE_TESTS, spheres_count);
+
+            if(triangles_count > 0)
+            {
+                TriangleSoa* triangles = &world->triangle_soa;
+                int index = world->kernels.intersect_triangles(triangles, ray.origin, ray.direction, triangles_first, triangles_count, min_hit_distance, &hit.distance);
+                if(index != -1)
+                {
+                    hit_primitive = triangles->primitive_indices[index];
+                    hit_triangle = index;
+                }
+            }
+
+            if(spheres_count > 0)
+            {
+                SphereSoa* spheres = &world->sphere_soa;
+                int index = world->kernels.intersect_spheres(spheres, ray.origin, ray.direction, spheres_first, spheres_count, min_hit_distance, &hit.distance);
+                if(index != -1)
+                {
+                    hit_primitive = spheres->primitive_indices[index];
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first by pushing it last.
+            const BvhNode* children = &bvh->nodes[node->first];
+            float entries[2];
+            bool hits[2];
+            hits[0] = aabb_intersect_ray(children[0].bounds, ray.origin, inverse_direction, hit.distance, &entries[0]);
+            hits[1] = aabb_intersect_ray(children[1].bounds, ray.origin, inverse_direction, hit.distance, &entries[1]);
+
+            int near = entries[1] < entries[0];
+            int far = 1 - near;
+
+            ASSERT(stack_count + 2 <= BVH_MAX_DEPTH);
+
+            if(hits[far])
+            {
+                node_stack[stack_count] = node->first + far;
+                entry_stack[stack_count] = entries[far];
+                stack_count += 1;
+            }
+            if(hits[near])
+            {
+                node_stack[stack_count] = node->first + near;
+                entry_stack[stack_count] = entries[near];
+                stack_count += 1;
+            }
+        }
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_PLANE_TESTS, world->planes_count);
+
+    for(int plane_index = 0;
+            plane_index < world->planes_count;
+            plane_index += 1)
+    {
+        Plane plane = world->planes[plane_index];
+
+        MaybeFloat intersection = intersect_ray_plane(ray, plane);
+
+        if(intersection.valid)
+        {
+            float distance = intersection.value;
+
+            if(distance > min_hit_distance && distance < hit.distance)
+            {
+                hit.light_index = -1;
+                hit.material_index = plane.material_index;
+                hit.distance = distance;
+                hit.normal = plane.normal;
+                hit_primitive = -1;
+            }
+        }
+    }
+
+    // Only the closest primitive needs its surface normal worked out.
+    if(hit_primitive != -1)
+    {
+        Primitive primitive = world->primitives[hit_primitive];
+        hit.light_index = primitive.light_index;
+
+        switch(primitive.type)
+        {
+            case PRIMITIVE_TYPE_SPHERE:
+            {
+                Sphere sphere = world->spheres[primitive.index];
+                Float3 hit_point = float3_add(float3_multiply(hit.distance, ray.direction), ray.origin);
+                hit.material_index = sphere.material_index;
+                hit.normal = float3_normalise(float3_subtract(hit_point, sphere.center));
+                break;
+            }
+            case PRIMITIVE_TYPE_TRIANGLE:
+            {
+                Mesh* mesh = &world->meshes[primitive.mesh_index];
+                TriangleSoa* triangles = &world->triangle_soa;
+
+                Float3 v0;
+                Float3 triangle_normal;
+                for(int axis = 0; axis < 3; axis += 1)
+                {
+                    v0.e[axis] = triangles->v0[axis][hit_triangle];
+                    triangle_normal.e[axis] = triangles->normal[axis][hit_triangle];
+                }
+
+                if(float3_dot(float3_subtract(ray.origin, v0), triangle_normal) < 0.0f)
+                {
+                    triangle_normal = float3_negate(triangle_normal);
+                }
+
+                hit.material_index = mesh->material_index;
+                hit.normal = triangle_normal;
+                break;
+            }
+        }
+    }
+
+    return hit;
+}
+
+// Whether anything lies along the ray closer than max_distance. Unlike
+// intersect_world it stops at the first hit it finds and doesn't work out
+// which hit is closest or what the surface there is like, so it's the one to
+// use for shadow rays.
+bool occluded(Ray ray, float max_distance, World* world)
+{
+    PROFILE_COUNT(PROFILE_COUNTER_SHADOW_RAYS, 1);
+
+    for(int plane_index = 0;
+            plane_index < world->planes_count;
+            plane_index += 1)
+    {
+        PROFILE_COUNT(PROFILE_COUNTER_PLANE_TESTS, 1);
+        MaybeFloat intersection = intersect_ray_plane(ray, world->planes[plane_index]);
+        if(intersection.valid
+                && intersection.value > min_hit_distance
+                && intersection.value < max_distance)
+        {
+            return true;
+        }
+    }
+
+    if(world->primitives_count == 0)
+    {
+        return false;
+    }
+
+    Bvh* bvh = &world->bvh;
+
+    Float3 inverse_direction;
+    inverse_direction.x = 1.0f / ray.direction.x;
+    inverse_direction.y = 1.0f / ray.direction.y;
+    inverse_direction.z = 1.0f / ray.direction.z;
+
+    int node_stack[BVH_MAX_DEPTH];
+    int stack_count = 0;
+
+    float entry;
+    if(aabb_intersect_ray(bvh->nodes[0].bounds, ray.origin, inverse_direction, max_distance, &entry))
+    {
+        node_stack[0] = 0;
+        stack_count = 1;
+    }
+
+    while(stack_count > 0)
+    {
+        stack_count -= 1;
+
+        const BvhNode* node = &bvh->nodes[node_stack[stack_count]];
+        PROFILE_COUNT(PROFILE_COUNTER_BVH_NODES, 1);
+
+        if(node->count > 0)
+        {
+            int triangles_first = world->triangle_prefix[node->first];
+            int triangles_count = world->triangle_prefix[node->first + node->count] - triangles_first;
+            int spheres_first = node->first - triangles_first;
+            int spheres_count = node->count - triangles_count;
+
+            PROFILE_COUNT(PROFILE_COUNTER_TRIANGLE_TESTS, triangles_count);
+            PROFILE_COUNT(PROFILE_COUNTER_SPHERE_TESTS, spheres_count);
+
+            // The kernels narrow the distance they're given, so each gets a
+            // copy.
+            float distance = max_distance;
+            if(triangles_count > 0
+                    && world->kernels.intersect_triangles(&world->triangle_soa, ray.origin, ray.direction, triangles_first, triangles_count, min_hit_distance, &distance) != -1)
+            {
+                return true;
+            }
+
+            if(spheres_count > 0
+                    && world->kernels.intersect_spheres(&world->sphere_soa, ray.origin, ray.direction, spheres_first, spheres_count, min_hit_distance, &distance) != -1)
+            {
+                return true;
+            }
+        }
+        else
+        {
+            // Any hit will do, so the order children are visited in only
+            // matters for how soon one turns up.
+            ASSERT(stack_count + 2 <= BVH_MAX_DEPTH);
+
+            for(int child = 0; child < 2; child += 1)
+            {
+                if(aabb_intersect_ray(bvh->nodes[node->first + child].bounds, ray.origin, inverse_direction, max_distance, &entry))
+                {
+                    node_stack[stack_count] = node->first + child;
+                    stack_count += 1;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+
+void world_create(World* world, Allocator* allocator)
+{
+    zero_memory(world, sizeof(World));
+    world->allocator = allocator;
+    world->environment_light_index = -1;
+    world->triangle_layout = TRIANGLE_LAYOUT_EDGES;
+    world->kernels = get_intersect_kernels(detect_simd_level(), world->triangle_layout);
+}
+
+void world_destroy(World* world)
+{
+    Allocator* allocator = world->allocator;
+
+    bvh_destroy(&world->bvh);
+    destroy_primitive_arrays(world);
+    destroy_lights(world);
+
+    deallocate(allocator, world->materials, sizeof(Material) * world->materials_cap);
+    deallocate(allocator, world->meshes, sizeof(Mesh) * world->meshes_cap);
+    deallocate(allocator, world->planes, sizeof(Plane) * world->planes_cap);
+    deallocate(allocator, world->primitives, sizeof(Primitive) * world->primitives_count);
+    deallocate(allocator, world->spheres, sizeof(Sphere) * world->spheres_cap);
+    deallocate(allocator, world->triangles, sizeof(Triangle) * world->triangles_cap);
+
+    zero_memory(world, sizeof(World));
+}
+
+int world_add_material(World* world, Material material)
+{
+    Material* materials = reserve(world->allocator, world->materials, &world->materials_cap, world->materials_count + 1, sizeof(Material));
+    if(!materials)
+    {
+        return -1;
+    }
+    world->materials = materials;
+
+    int index = world->materials_count;
+    world->materials[index] = material;
+    world->materials_count += 1;
+
+    return index;
+}
+
+int world_add_mesh(World* world, const Triangle* triangles, int triangles_count, uint32_t material_index)
+{
+    Mesh* meshes = reserve(world->allocator, world->meshes, &world->meshes_cap, world->meshes_count + 1, sizeof(Mesh));
+    if(!meshes)
+    {
+        return -1;
+    }
+    world->meshes = meshes;
+
+    Triangle* all_triangles = reserve(world->allocator, world->triangles, &world->triangles_cap, world->triangles_count + triangles_count, sizeof(Triangle));
+    if(!all_triangles)
+    {
+        return -1;
+    }
+    world->triangles = all_triangles;
+
+    copy_memory(&world->triangles[world->triangles_count], triangles, sizeof(Triangle) * triangles_count);
+
+    int index = world->meshes_count;
+    Mesh* mesh = &world->meshes[index];
+    mesh->first_triangle = world->triangles_count;
+    mesh->triangles_count = triangles_count;
+    mesh->material_index = material_index;
+
+    world->meshes_count += 1;
+    world->triangles_count += triangles_count;
+
+    return index;
+}
+
+int world_add_plane(World* world, Plane plane)
+{
+    Plane* planes = reserve(world->allocator, world->planes, &world->planes_cap, world->planes_count + 1, sizeof(Plane));
+    if(!planes)
+    {
+        return -1;
+    }
+    world->planes = planes;
+
+    int index = world->planes_count;
+    world->planes[index] = plane;
+    world->planes_count += 1;
+
+    return index;
+}
+
+int world_add_sphere(World* world, Sphere sphere)
+{
+    Sphere* spheres = reserve(world->allocator, world->spheres, &world->spheres_cap, world->spheres_count + 1, sizeof(Sphere));
+    if(!spheres)
+    {
+        return -1;
+    }
+    world->spheres = spheres;
+
+    int index = world->spheres_count;
+    world->spheres[index] = sphere;
+    world->spheres_count += 1;
+
+    return index;
+}
@@ -0,0 +1,156 @@
+#ifndef WORLD_H_
+#define WORLD_H_
+
+#include "bvh.h"
+#include "intersect_simd.h"
+#include "memory.h"
+#include "vector_math.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Material
+{
+    Float3 emittance;
+    Float3 reflectance;
+    float glossiness;
+} Material;
+
+typedef struct Triangle
+{
+    Float3 vertices[3];
+} Triangle;
+
+// A mesh is a run of triangles in the world's flat triangle array.
+typedef struct Mesh
+{
+    int first_triangle;
+    int triangles_count;
+    uint32_t material_index;
+} Mesh;
+
+typedef struct Plane
+{
+    Float3 normal;
+    float d;
+    uint32_t material_index;
+} Plane;
+
+typedef struct Ray
+{
+    Float3 origin;
+    Float3 direction;
+} Ray;
+
+typedef struct Sphere
+{
+    Float3 center;
+    float radius;
+    uint32_t material_index;
+} Sphere;
+
+typedef enum LightType
+{
+    LIGHT_TYPE_ENVIRONMENT,
+    LIGHT_TYPE_SPHERE,
+    LIGHT_TYPE_TRIANGLE,
+} LightType;
+
+// An emitter that can be sampled directly. Index refers to the world's
+// spheres or triangles, and is unused for the environment, which is the
+// background material.
+typedef struct Light
+{
+    LightType type;
+    int index;
+    uint32_t material_index;
+} Light;
+
+typedef enum PrimitiveType
+{
+    PRIMITIVE_TYPE_SPHERE,
+    PRIMITIVE_TYPE_TRIANGLE,
+} PrimitiveType;
+
+// A reference to one bounded primitive in the world, which is what the
+// bounding volume hierarchy is built over. Planes are unbounded so they're
+// kept out of the hierarchy and tested separately.
+typedef struct Primitive
+{
+    PrimitiveType type;
+    int index;
+    int light_index;
+    int mesh_index;
+} Primitive;
+
+// All of the arrays grow on demand using the world's allocator. Triangles
+// from every mesh are stored together in one contiguous array.
+//
+// Building the hierarchy also copies the bounded primitives into
+// structure-of-arrays form in leaf order. For each slot of the hierarchy's
+// primitive indices, triangle_prefix holds the number of triangles in the
+// slots before it. The triangle layout is chosen before building.
+//
+// Building also collects every emissive sphere and triangle into the light
+// list, plus the background if it emits, as the environment light.
+typedef struct World
+{
+    Allocator* allocator;
+    Bvh bvh;
+    IntersectKernels kernels;
+    Light* lights;
+    SphereSoa sphere_soa;
+    TriangleSoa triangle_soa;
+    TriangleLayout triangle_layout;
+    Material* materials;
+    Mesh* meshes;
+    Plane* planes;
+    Primitive* primitives;
+    Sphere* spheres;
+    Triangle* triangles;
+    int* triangle_prefix;
+    int environment_light_index;
+    int lights_count;
+    int materials_cap;
+    int materials_count;
+    int meshes_cap;
+    int meshes_count;
+    int planes_cap;
+    int planes_count;
+    int primitives_count;
+    int spheres_cap;
+    int spheres_count;
+    int triangles_cap;
+    int triangles_count;
+} World;
+
+typedef struct MaybeFloat
+{
+    float value;
+    bool valid;
+} MaybeFloat;
+
+// Light index is the entry in the world's light list of whatever was hit, or
+// -1 if it isn't a light.
+typedef struct Hit
+{
+    Float3 normal;
+    float distance;
+    int light_index;
+    int material_index;
+} Hit;
+
+MaybeFloat intersect_ray_plane(Ray ray, Plane plane);
+Hit intersect_world(Ray ray, World* world);
+bool occluded(Ray ray, float max_distance, World* world);
+
+void world_create(World* world, Allocator* allocator);
+void world_destroy(World* world);
+int world_add_material(World* world, Material material);
+int world_add_mesh(World* world, const Triangle* triangles, int triangles_count, uint32_t material_index);
+int world_add_plane(World* world, Plane plane);
+int world_add_sphere(World* world, Sphere sphere);
+bool world_build_bvh(World* world);
+bool world_load_bvh(World* world, const BvhNode* nodes, int nodes_count, const int* primitive_indices, int primitives_count);
+
+#endif // WORLD_H_